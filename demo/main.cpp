@@ -444,7 +444,7 @@ int main(int argc, char **argv)
 
                 // Because the birthdte column is of type datetime (and not null) 
                 // DBItem's type selector m_nVarType is set to DBItem::lwvt_date
-                // and its pointer member m_pdate is set to a valid TIMESTAMP_STRUCT
+                // and its member m_dateVal holds a valid TIMESTAMP_STRUCT
                 assert(varBirthDte.m_nVarType == DBItem::lwvt_date);
 
                 // ********************************************************************
@@ -497,8 +497,8 @@ int main(int argc, char **argv)
                 query.GetFieldValue(4, g);	// ODBC C type is implicitly set by the parameter of type GUID.
                     
                 tcout << lfnbr << _T("\t") << sName << _T("\t");
-                if (varBirthDte.m_pdate)
-                    _tprintf(_T("%02d.%02d.%04d\t"), varBirthDte.m_pdate->day, varBirthDte.m_pdate->month, varBirthDte.m_pdate->year);
+                if (varBirthDte.m_nVarType == DBItem::lwvt_date)
+                    _tprintf(_T("%02d.%02d.%04d\t"), varBirthDte.m_dateVal.day, varBirthDte.m_dateVal.month, varBirthDte.m_dateVal.year);
                 _tprintf(_T("%8.2f\t"), d);
      
                 // Of course fields can be NULL and be recognized as such 
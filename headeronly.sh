@@ -2,5 +2,5 @@
 mkdir headeronly 
 cd query
 cat tstring.h std_includes.h > ../headeronly/odbcquery.hpp
-cat odbcexception.h connection.h dbitem.h fieldinfo.h resultinfo.h datarow.h paraminfo.h paramitem.h query.h table.h lvstring.h odbcenvironment.h connection.cpp dbitem.cpp fieldinfo.cpp resultinfo.cpp datarow.cpp paramitem.cpp lvstring.cpp query.cpp odbcexception.cpp odbcenvironment.cpp table.cpp | grep -iv "#include" | grep -iv "#pragma once" >> ../headeronly/odbcquery.hpp
+cat odbcexception.h memoryresource.h dbitem.h fieldinfo.h resultinfo.h paraminfo.h connection.h datarow.h paramitem.h columnbinding.h columnbatch.h connectionpool.h spscqueue.h threadpool.h queryexecutor.h watchdog.h columnformatter.h rowformatter.h query.h table.h lvstring.h odbcenvironment.h connection.cpp memoryresource.cpp dbitem.cpp fieldinfo.cpp resultinfo.cpp datarow.cpp paramitem.cpp lvstring.cpp columnbinding.cpp columnbatch.cpp connectionpool.cpp threadpool.cpp queryexecutor.cpp watchdog.cpp columnformatter.cpp rowformatter.cpp query.cpp odbcexception.cpp odbcenvironment.cpp table.cpp | grep -iv "#include" | grep -iv "#pragma once" >> ../headeronly/odbcquery.hpp
 cd ..
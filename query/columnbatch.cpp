@@ -0,0 +1,148 @@
+#include "columnbatch.h"
+#include <cassert>
+#include <cstring>
+
+using namespace linguversa;
+using namespace std;
+
+ColumnVector::ColumnVector()
+{
+    m_nType = cv_string;
+    m_nSize = 0;
+    m_Offsets.push_back(0);
+}
+
+ColumnVector::columntype ColumnVector::GetColumnType(const FieldInfo& fieldinfo)
+{
+    switch (FieldInfo::GetDefaultCType(fieldinfo))
+    {
+    case SQL_C_BIT:
+    case SQL_C_UTINYINT:
+    case SQL_C_SHORT:
+    case SQL_C_LONG:
+        return cv_int32;
+    case SQL_C_SLONG:   // numeric/decimal with up to 10 digits might not fit into 32 bit
+    case SQL_C_UBIGINT:
+        return cv_int64;
+    case SQL_C_FLOAT:
+    case SQL_C_DOUBLE:
+        return cv_double;
+    case SQL_C_TIMESTAMP:
+        return cv_timestamp;
+    case SQL_C_BINARY:
+    case SQL_C_GUID:
+        return cv_binary;
+    default:
+        return cv_string;
+    }
+}
+
+SQLSMALLINT ColumnVector::GetCType(columntype type)
+{
+    switch (type)
+    {
+    case cv_int32:
+        return SQL_C_SLONG;
+    case cv_int64:
+        return SQL_C_SBIGINT;
+    case cv_double:
+        return SQL_C_DOUBLE;
+    case cv_timestamp:
+        return SQL_C_TIMESTAMP;
+    case cv_binary:
+        return SQL_C_BINARY;
+    default:
+        return SQL_C_TCHAR;
+    }
+}
+
+void ColumnVector::Reset(columntype type)
+{
+    m_nType = type;
+    m_nSize = 0;
+    // clear() keeps the capacity of the vectors
+    m_Int32.clear();
+    m_Int64.clear();
+    m_Double.clear();
+    m_Timestamp.clear();
+    m_Offsets.clear();
+    m_Offsets.push_back(0);
+    m_Data.clear();
+    m_Validity.clear();
+}
+
+tstring ColumnVector::GetString(size_t nRow) const
+{
+    assert(nRow < m_nSize && m_nType == cv_string);
+    if (IsNull(nRow))
+        return tstring();
+
+    size_t nBytes = m_Offsets[nRow + 1] - m_Offsets[nRow];
+    tstring s(nBytes / sizeof(TCHAR), (TCHAR) 0);
+    if (nBytes > 0)
+        memcpy(&s[0], &m_Data[m_Offsets[nRow]], nBytes);
+    return s;
+}
+
+bytearray ColumnVector::GetBytes(size_t nRow) const
+{
+    assert(nRow < m_nSize);
+    return bytearray(m_Data.begin() + m_Offsets[nRow], m_Data.begin() + m_Offsets[nRow + 1]);
+}
+
+void ColumnVector::AppendRow(bool bValid)
+{
+    if ((m_nSize & 7) == 0)
+        m_Validity.push_back(0);
+    if (bValid)
+        m_Validity[m_nSize >> 3] |= (unsigned char) (1 << (m_nSize & 7));
+    m_nSize++;
+    m_Offsets.push_back(m_Data.size());
+}
+
+void ColumnVector::AppendNull()
+{
+    // keep the fixed width arrays in step with the row numbers
+    switch (m_nType)
+    {
+    case cv_int32:
+        m_Int32.push_back(0);
+        break;
+    case cv_int64:
+        m_Int64.push_back(0);
+        break;
+    case cv_double:
+        m_Double.push_back(0.0);
+        break;
+    case cv_timestamp:
+    {
+        TIMESTAMP_STRUCT ts;
+        memset(&ts, 0, sizeof(ts));
+        m_Timestamp.push_back(ts);
+    } break;
+    default:
+        break;
+    }
+    AppendRow(false);
+}
+
+ColumnBatch::ColumnBatch()
+{
+    m_nRows = 0;
+}
+
+void ColumnBatch::Init(const ResultInfo& resultinfo)
+{
+    m_ResultInfo = resultinfo;
+    m_Columns.resize(resultinfo.size());
+    for (size_t col = 0; col < resultinfo.size(); col++)
+        m_Columns[col].Reset(ColumnVector::GetColumnType(resultinfo[col]));
+    m_nRows = 0;
+}
+
+void ColumnBatch::clear()
+{
+    for (size_t col = 0; col < m_Columns.size(); col++)
+        m_Columns[col].Reset(m_Columns[col].GetType());
+    m_nRows = 0;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "tstring.h"
+#include "dbitem.h"
+#include "resultinfo.h"
+
+#include <sql.h>
+#include <sqlext.h>
+#include <vector>
+
+namespace linguversa
+{
+    // The values of one result column for all rows of a ColumnBatch.
+    // Depending on the column type exactly one of the contiguous arrays is filled,
+    // with one element per row (a zero value for null rows).
+    // Strings and binary data are stored back to back in m_Data, the value of row i
+    // is the byte range [m_Offsets[i], m_Offsets[i + 1]). For string columns these bytes are TCHARs.
+    // Bit i of m_Validity is set if row i is not null.
+    class ColumnVector
+    {
+    public:
+        typedef enum {
+            cv_int32,     // SQL_C_SLONG: bit, tinyint, smallint, integer
+            cv_int64,     // SQL_C_SBIGINT: bigint, numeric/decimal without scale
+            cv_double,    // SQL_C_DOUBLE: real, float, double, numeric/decimal with scale
+            cv_timestamp, // SQL_C_TIMESTAMP: date, time, timestamp
+            cv_string,    // SQL_C_TCHAR: character data and everything else
+            cv_binary     // SQL_C_BINARY: binary and guid
+        } columntype;
+
+        ColumnVector();
+
+        // Maps the sql type of a column to the type of its ColumnVector.
+        static columntype GetColumnType(const FieldInfo& fieldinfo);
+        // The ODBC C type used to retrieve the values of a column of this type.
+        static SQLSMALLINT GetCType(columntype type);
+
+        // Remove all values and set the type, the allocated buffers are kept.
+        void Reset(columntype type);
+        columntype GetType() const { return m_nType; };
+        size_t size() const { return m_nSize; };
+
+        bool IsNull(size_t nRow) const { return (m_Validity[nRow >> 3] & (1 << (nRow & 7))) == 0; };
+        std::tstring GetString(size_t nRow) const;
+        bytearray GetBytes(size_t nRow) const;
+
+        // Append one row; the value itself has to be appended to the corresponding array before
+        // (or to m_Data for strings and binary data).
+        void AppendRow(bool bValid);
+        void AppendNull();
+
+        std::vector<SQLINTEGER> m_Int32;
+        std::vector<SQLBIGINT> m_Int64;
+        std::vector<double> m_Double;
+        std::vector<TIMESTAMP_STRUCT> m_Timestamp;
+        std::vector<size_t> m_Offsets;  // m_Offsets.size() == size() + 1
+        bytearray m_Data;
+        bytearray m_Validity;
+
+    protected:
+        columntype m_nType;
+        size_t m_nSize;
+    };
+
+    // A block of up to N rows in column-major layout, filled by Query::FetchBatch().
+    class ColumnBatch
+    {
+    public:
+        ColumnBatch();
+
+        // Set up one ColumnVector for each column of the result set and remove all rows.
+        // The buffers of the ColumnVectors are kept, so a batch can be reused for the next N rows
+        // without new allocations.
+        void Init(const ResultInfo& resultinfo);
+        // Remove all rows, keep columns and buffers.
+        void clear();
+
+        size_t GetRowCount() const { return m_nRows; };
+        size_t GetColumnCount() const { return m_Columns.size(); };
+        const ResultInfo& GetResultInfo() const { return m_ResultInfo; };
+
+        ColumnVector& operator[](size_t nCol) { return m_Columns[nCol]; };
+        const ColumnVector& operator[](size_t nCol) const { return m_Columns[nCol]; };
+
+    protected:
+        ResultInfo m_ResultInfo;
+        std::vector<ColumnVector> m_Columns;
+        size_t m_nRows;
+
+        friend class Query;
+    };
+}
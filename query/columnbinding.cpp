@@ -0,0 +1,115 @@
+#include "columnbinding.h"
+#include <cassert>
+#include <cstring>
+
+using namespace linguversa;
+using namespace std;
+
+ColumnBinding::ColumnBinding(SQLSMALLINT nCType, SQLULEN nRows)
+{
+    m_nCType = nCType;
+    m_nElementSize = GetElementSize(nCType);
+    assert(m_nElementSize > 0);
+    m_Buffer.resize(m_nElementSize * nRows);
+    m_LenInd.resize(nRows, SQL_NULL_DATA);
+}
+
+SQLLEN ColumnBinding::GetElementSize(SQLSMALLINT nCType)
+{
+    switch (nCType)
+    {
+    case SQL_C_BIT:
+    case SQL_C_UTINYINT:
+        return sizeof(SQLCHAR);
+    case SQL_C_SHORT:
+        return sizeof(SQLSMALLINT);
+    case SQL_C_LONG:
+        // SQL_C_LONG is a 32 bit SQLINTEGER, even where long has 64 bit.
+        return sizeof(SQLINTEGER);
+    case SQL_C_FLOAT:
+        return sizeof(SQLREAL);
+    case SQL_C_DOUBLE:
+        return sizeof(SQLDOUBLE);
+    case SQL_C_TIMESTAMP:
+        return sizeof(TIMESTAMP_STRUCT);
+    case SQL_C_UBIGINT:
+        return sizeof(SQLUBIGINT);
+    case SQL_C_GUID:
+        return sizeof(SQLGUID);
+    default:
+        return 0;
+    }
+}
+
+SQLRETURN ColumnBinding::Bind(HSTMT hstmt, SQLUSMALLINT nColumn)
+{
+    return ::SQLBindCol(hstmt, nColumn, m_nCType, m_Buffer.data(), m_nElementSize, m_LenInd.data());
+}
+
+SQLLEN ColumnBinding::GetValue(SQLULEN nRow, DBItem& varValue) const
+{
+    assert(nRow < m_LenInd.size());
+    varValue.reset();
+
+    SQLLEN len = m_LenInd[nRow];
+    if (len == SQL_NULL_DATA)
+        return len;
+
+    // The buffer is a byte array, so copy the element instead of casting to avoid misaligned access.
+    const unsigned char* pElement = GetElement(nRow);
+    switch (m_nCType)
+    {
+    case SQL_C_BIT:
+        varValue.m_nVarType = DBItem::lwvt_bool;
+        varValue.m_boolVal = (*pElement ? true : false);
+        break;
+    case SQL_C_UTINYINT:
+        varValue.m_nVarType = DBItem::lwvt_uchar;
+        varValue.m_chVal = *pElement;
+        break;
+    case SQL_C_SHORT:
+    {
+        SQLSMALLINT sValue;
+        memcpy(&sValue, pElement, sizeof(sValue));
+        varValue.m_nVarType = DBItem::lwvt_short;
+        varValue.m_iVal = sValue;
+    } break;
+    case SQL_C_LONG:
+    {
+        SQLINTEGER lValue;
+        memcpy(&lValue, pElement, sizeof(lValue));
+        varValue.m_nVarType = DBItem::lwvt_long;
+        varValue.m_lVal = lValue;
+    } break;
+    case SQL_C_FLOAT:
+    {
+        SQLREAL fValue;
+        memcpy(&fValue, pElement, sizeof(fValue));
+        varValue.m_nVarType = DBItem::lwvt_single;
+        varValue.m_fltVal = fValue;
+    } break;
+    case SQL_C_DOUBLE:
+    {
+        SQLDOUBLE dValue;
+        memcpy(&dValue, pElement, sizeof(dValue));
+        varValue.m_nVarType = DBItem::lwvt_double;
+        varValue.m_dblVal = dValue;
+    } break;
+    case SQL_C_TIMESTAMP:
+        varValue.m_nVarType = DBItem::lwvt_date;
+        memcpy(&varValue.m_dateVal, pElement, sizeof(TIMESTAMP_STRUCT));
+        break;
+    case SQL_C_UBIGINT:
+        varValue.m_nVarType = DBItem::lwvt_uint64;
+        memcpy(&varValue.m_ui64Val, pElement, sizeof(SQLUBIGINT));
+        break;
+    case SQL_C_GUID:
+        varValue.m_nVarType = DBItem::lwvt_guid;
+        memcpy(&varValue.m_guidVal, pElement, sizeof(SQLGUID));
+        break;
+    default:
+        assert(false);
+    }
+
+    return len;
+}
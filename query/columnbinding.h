@@ -0,0 +1,40 @@
+#pragma once
+
+#include "dbitem.h"
+
+#include <sql.h>
+#include <sqlext.h>
+#include <vector>
+
+namespace linguversa
+{
+    // internal helper class
+    // Column-wise buffer for one result column which is bound with SQLBindCol()
+    // while the query fetches a block of rows at once (see Query::SetRowsetSize()).
+    class ColumnBinding
+    {
+    protected:
+        SQLSMALLINT m_nCType;         // ODBC C type of the bound buffer
+        SQLLEN m_nElementSize;        // size of one element in bytes
+        bytearray m_Buffer;           // m_nRows elements of m_nElementSize bytes
+        std::vector<SQLLEN> m_LenInd; // length / indicator for each row of the rowset
+
+        ColumnBinding(SQLSMALLINT nCType, SQLULEN nRows);
+
+        // Size of the C type in a bound buffer, 0 for variable length types (character, binary)
+        // which are not bound but read with SQLGetData().
+        static SQLLEN GetElementSize(SQLSMALLINT nCType);
+
+        // Bind the buffer to column nColumn (1-based) of hstmt.
+        SQLRETURN Bind(HSTMT hstmt, SQLUSMALLINT nColumn);
+
+        // Start of the element of row nRow (0-based position within the rowset).
+        const unsigned char* GetElement(SQLULEN nRow) const { return m_Buffer.data() + nRow * m_nElementSize; };
+
+        // Copy the value of row nRow (0-based position within the rowset) into varValue.
+        // Returns the length / indicator of that row, i.e. SQL_NULL_DATA for null values.
+        SQLLEN GetValue(SQLULEN nRow, DBItem& varValue) const;
+
+        friend class Query;
+    };
+}
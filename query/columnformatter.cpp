@@ -0,0 +1,167 @@
+#include "columnformatter.h"
+#include "lvstring.h"
+
+using namespace std;
+using namespace linguversa;
+
+TCHAR ConvertNationalDecSeparator( tstring& DecimalFormat)
+{
+    size_t n = 0;
+    TCHAR ret;
+    if ((n = DecimalFormat.find(_T(','), 0)) != tstring::npos && DecimalFormat.find(_T(','), n + 1) == tstring::npos)
+    {
+        ret = DecimalFormat[n];
+        DecimalFormat[n] = _T('.');
+        return ret;
+    }
+
+    return _T('\0');
+}
+
+// The integer format for 64 bit values: the length modifier of a trailing integer conversion becomes ll,
+// e.g. %0d -> %0lld, other formats are kept.
+static tstring Int64Format( const tstring& IntFormat)
+{
+    size_t n = IntFormat.length();
+    if (n < 2 || tstring(_T("diuxXo")).find(IntFormat[n - 1]) == tstring::npos)
+        return IntFormat;
+    size_t nMod = n - 1;
+    while (nMod > 0 && (IntFormat[nMod - 1] == _T('l') || IntFormat[nMod - 1] == _T('h')))
+        nMod--;
+    return IntFormat.substr(0, nMod) + _T("ll") + IntFormat.substr(n - 1);
+}
+
+ColumnFormatter::ColumnFormatter( const tstring& colFmt)
+    : m_Format(colFmt)
+{
+    // get the Default for NULL value, empty string if not specified
+    size_t nPos = m_Format.find( _T("|"));
+    if (nPos != tstring::npos)
+    {
+        m_NullDefault = m_Format.substr(nPos + 1);
+        m_Format.erase(nPos);
+    }
+    m_bPercent = m_Format.find(_T('%')) != tstring::npos;
+
+    m_IntFormat = m_Format.empty() ? tstring(_T("%0d")) : m_Format;
+    m_IntNumberFormat = DBItem::NumberFormat( m_IntFormat);
+    m_Int64Format = Int64Format( m_IntFormat);
+    // SQL_BIGINT is read as SQL_C_UBIGINT, %d and %i restore the sign
+    TCHAR cConversion = m_IntFormat.empty() ? _T('\0') : m_IntFormat[m_IntFormat.length() - 1];
+    m_bSignedInt64 = (cConversion == _T('d') || cConversion == _T('i'));
+
+    tstring DecimalFormat = m_Format;
+    m_cNationalDecSep = ::ConvertNationalDecSeparator( DecimalFormat);
+    m_SingleFormat = DecimalFormat.empty() ? tstring(_T("%0.3f")) : DecimalFormat;
+    m_DoubleFormat = DecimalFormat.empty() ? tstring(_T("%0.6f")) : DecimalFormat;
+    m_SingleNumberFormat = DBItem::NumberFormat( m_SingleFormat);
+    m_DoubleNumberFormat = DBItem::NumberFormat( m_DoubleFormat);
+}
+
+tstring ColumnFormatter::Format( const DBItem& var) const
+{
+    tstring sValue;
+    Format( var, sValue);
+    return sValue;
+}
+
+void ColumnFormatter::Format( const DBItem& var, tstring& sValue) const
+{
+    size_t nPos = 0;
+
+    // format var according to its type
+    switch (var.m_nVarType)
+    {
+    case DBItem::lwvt_bool:
+        if (!m_IntNumberFormat.Format( (long long) var.m_boolVal, sValue))
+            sValue = linguversa::string_format( m_IntFormat, (unsigned char) var.m_boolVal);
+        break;
+    case DBItem::lwvt_uchar:
+        if (!m_IntNumberFormat.Format( (long long) var.m_chVal, sValue))
+            sValue = linguversa::string_format( m_IntFormat, var.m_chVal);
+        break;
+    case DBItem::lwvt_short:
+        if (!m_IntNumberFormat.Format( (long long) var.m_iVal, sValue))
+            sValue = linguversa::string_format( m_IntFormat, var.m_iVal);
+        break;
+    case DBItem::lwvt_long:
+        if (!m_IntNumberFormat.Format( (long long) var.m_lVal, sValue))
+            sValue = linguversa::string_format( m_IntFormat, var.m_lVal);
+        break;
+    case DBItem::lwvt_single:
+        if (!m_SingleNumberFormat.Format( (double) var.m_fltVal, sValue))
+            sValue = linguversa::string_format( m_SingleFormat, var.m_fltVal);
+        if (m_cNationalDecSep && (nPos = sValue.find(_T('.'), 0)) != tstring::npos)
+            sValue[nPos] = m_cNationalDecSep;
+        break;
+    case DBItem::lwvt_double: 
+        if (!m_DoubleNumberFormat.Format( var.m_dblVal, sValue))
+            sValue = linguversa::string_format( m_DoubleFormat, var.m_dblVal);
+        if (m_cNationalDecSep && (nPos = sValue.find(_T('.'), 0)) != tstring::npos)
+            sValue[nPos] = m_cNationalDecSep;
+        break;
+    case DBItem::lwvt_date:
+        sValue = linguversa::FormatTimeStamp( m_Format, &var.m_dateVal);
+        break;
+    case DBItem::lwvt_string:
+        if (m_bPercent)
+            sValue = string_format(m_Format, var.GetString());
+        else
+            sValue.assign(var.GetString(), var.GetDataLength() / sizeof(TCHAR));
+        break;
+    #ifdef UNICODE
+    case DBItem::lwvt_wstring:
+        if (m_bPercent)
+            sValue = string_format(m_Format, wstring(var.GetStringW(), var.GetDataLength() / sizeof(wchar_t)).c_str());
+        else
+            sValue.assign(var.GetStringW(), var.GetDataLength() / sizeof(wchar_t));
+        break;
+    #else
+    case DBItem::lwvt_astring:
+        if (m_bPercent)
+            sValue = string_format(m_Format, string(var.GetStringA(), var.GetDataLength()).c_str());
+        else
+            sValue.assign(var.GetStringA(), var.GetDataLength());
+        break;
+    #endif
+
+    case DBItem::lwvt_bytearray:
+        {
+            static const TCHAR hex[] = _T("0123456789abcdef");
+            const unsigned char* ba = var.GetData();
+            size_t nLen = var.GetDataLength();
+            sValue.assign(nLen ? 2 + 2 * nLen : 0, _T('0'));
+            if (nLen)
+                sValue[1] = _T('x');
+            for (size_t i = 0; i < nLen; i++)
+            {
+                sValue[2 + 2 * i] = hex[ba[i] >> 4];
+                sValue[3 + 2 * i] = hex[ba[i] & 0x0f];
+            }
+        }
+        break;
+    case DBItem::lwvt_uint64:
+        if (m_bSignedInt64)
+        {
+            if (!m_IntNumberFormat.Format( (long long) var.m_ui64Val, sValue))
+                sValue = string_format( m_Int64Format, (long long) var.m_ui64Val);
+        }
+        else if (!m_IntNumberFormat.Format( (unsigned long long) var.m_ui64Val, sValue))
+            sValue = string_format( m_Int64Format, (unsigned long long) var.m_ui64Val);
+        break;
+    case DBItem::lwvt_guid:
+        {
+            const SQLGUID& g = var.m_guidVal;
+            sValue = string_format( _T("%08lx-%04x-%04x-%02x%02x-%02x%02x%02x%02x%02x%02x\n"), 
+                g.Data1, g.Data2, g.Data3, 
+                g.Data4[0], g.Data4[1], g.Data4[2], g.Data4[3], g.Data4[4], g.Data4[5], g.Data4[6], g.Data4[7]);
+        }
+        break;
+    case DBItem::lwvt_null:
+        sValue = m_NullDefault;
+        break;
+    default:
+        sValue = _T("<undefined>");
+        break;
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "tstring.h"
+#include "dbitem.h"
+
+namespace linguversa
+{
+    // The column format of DBItem::ConvertToString(), parsed once: the default for null values
+    // behind '|', the national decimal separator and the printf-style formats of the numeric types.
+    // Format(var) returns the same as DBItem::ConvertToString(var, colFmt), but per value without
+    // any string parsing, which pays off when many values are formatted the same way.
+    class ColumnFormatter
+    {
+    public:
+        explicit ColumnFormatter( const std::tstring& colFmt = _T(""));
+
+        std::tstring Format( const DBItem& var) const;
+        // assigns the formatted value to sValue, whose buffer is reused
+        void Format( const DBItem& var, std::tstring& sValue) const;
+
+        const std::tstring& GetNullDefault() const { return m_NullDefault; };
+
+    protected:
+        std::tstring m_Format;          // without the null default
+        std::tstring m_NullDefault;
+        bool m_bPercent;                // strings are formatted with printf only if m_Format contains '%'
+        std::tstring m_IntFormat;       // m_Format or %0d
+        DBItem::NumberFormat m_IntNumberFormat;
+        std::tstring m_Int64Format;     // m_IntFormat with ll for 64 bit values
+        bool m_bSignedInt64;            // 64 bit values are formatted as signed (%d, %i)
+        TCHAR m_cNationalDecSep;        // replaces '.' in decimal values, 0 if not specified
+        std::tstring m_SingleFormat;    // decimal format with '.' or %0.3f
+        std::tstring m_DoubleFormat;    // decimal format with '.' or %0.6f
+        DBItem::NumberFormat m_SingleNumberFormat;
+        DBItem::NumberFormat m_DoubleNumberFormat;
+    };
+}
@@ -7,25 +7,47 @@ using namespace std;
 
 SQLHENV Connection::m_henv = SQL_NULL_HENV;
 int Connection::m_ConnectionCounter = 0;
+std::mutex Connection::m_EnvMutex;
 
 Connection::Connection()
 {
     m_hdbc = NULL;
+    m_bInTransaction = false;
+    m_nDescribeCacheSize = 0;
+    m_nQueryTimeout = 0;
+    m_nStatementCacheSize = 0;
+    m_nStatementCacheHits = 0;
+    m_nStatementCacheMisses = 0;
+    m_nStatementPoolSize = 0;
+    m_nStatementPoolHits = 0;
+    m_nStatementPoolMisses = 0;
+
+    // The environment is shared by all connections, possibly of different threads:
+    // allocating, counting and freeing it must not interleave.
+    lock_guard<mutex> lock(m_EnvMutex);
     if (m_henv == SQL_NULL_HENV)
     {
-        SQLRETURN retcode = SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &m_henv);
+        SQLHENV henv = SQL_NULL_HENV;
+        SQLRETURN retcode = SQLAllocHandle(SQL_HANDLE_ENV, SQL_NULL_HANDLE, &henv);
         if (! SQL_SUCCEEDED(retcode))
-            throw DbException( retcode, SQL_HANDLE_ENV, m_henv);
+            throw DbException( retcode, SQL_HANDLE_ENV, henv);
         
-        retcode = SQLSetEnvAttr(m_henv, SQL_ATTR_ODBC_VERSION, (void *) SQL_OV_ODBC3, 0);
+        retcode = SQLSetEnvAttr(henv, SQL_ATTR_ODBC_VERSION, (void *) SQL_OV_ODBC3, 0);
         if (! SQL_SUCCEEDED(retcode)) 
-            throw DbException( retcode, SQL_HANDLE_ENV, m_henv);
+        {
+            DbException ex( retcode, SQL_HANDLE_ENV, henv);
+            ::SQLFreeHandle( SQL_HANDLE_ENV, henv);
+            throw ex;
+        }
 
         // SQL_ATTR_METADATA_ID: The default value is SQL_FALSE.
         // The arguments of catalog functions can either contain a string search pattern or not, depending on the argument. 
         // Case is significant.
         // SQL_ATTR_METADATA_ID can also be set on the statement level. 
         // (It is the only connection attribute that is also a statement attribute.)
+
+        // publish the handle only when it is completely set up
+        m_henv = henv;
     }
     
     if (m_henv != SQL_NULL_HENV)
@@ -43,6 +65,7 @@ Connection::~Connection()
     if (m_hdbc != SQL_NULL_HDBC)
         Close();
     
+    lock_guard<mutex> lock(m_EnvMutex);
     if (m_ConnectionCounter > 0)
         m_ConnectionCounter--;
     else
@@ -126,8 +149,22 @@ bool Connection::IsOpen() const
 
 void Connection::Close()
 {
+    // the cached and pooled statements must be freed before the connection
+    ClearStatementCache();
+    for (HSTMT hstmt : m_FreeStatements)
+        ::SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+    m_FreeStatements.clear();
+
     if (m_hdbc != SQL_NULL_HDBC)
     {
+        // SQLDisconnect fails while a transaction is open
+        if (m_bInTransaction)
+        {
+            ::SQLEndTran(SQL_HANDLE_DBC, m_hdbc, SQL_ROLLBACK);
+            ::SQLSetConnectAttr(m_hdbc, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER) SQL_AUTOCOMMIT_ON, SQL_IS_UINTEGER);
+            m_bInTransaction = false;
+        }
+
         SQLRETURN retcode = ::SQLDisconnect(m_hdbc);
         // !his yields -1 if we are not yet connected!
         //assert( SQL_SUCCEEDED(retcode));
@@ -137,6 +174,197 @@ void Connection::Close()
         // prevent unused variable warning/error in release mode
         (void)retcode;
     }
+
+    m_DescribeCache.clear();
+}
+
+bool Connection::IsDead() const
+{
+    if (m_hdbc == SQL_NULL_HDBC)
+        return true;
+
+    SQLUINTEGER nDead = SQL_CD_FALSE;
+    SQLRETURN retcode = ::SQLGetConnectAttr(m_hdbc, SQL_ATTR_CONNECTION_DEAD, &nDead, SQL_IS_UINTEGER, nullptr);
+    return SQL_SUCCEEDED(retcode) && nDead == SQL_CD_TRUE;
+}
+
+SQLRETURN Connection::SetDriverManagerPooling(SQLUINTEGER nPooling)
+{
+    lock_guard<mutex> lock(m_EnvMutex);
+    if (m_henv != SQL_NULL_HENV)
+        return SQL_ERROR;
+
+    // a process level attribute, therefore set on the null handle
+    return ::SQLSetEnvAttr(SQL_NULL_HANDLE, SQL_ATTR_CONNECTION_POOLING, (SQLPOINTER) (size_t) nPooling, SQL_IS_UINTEGER);
+}
+
+SQLRETURN Connection::BeginTransaction()
+{
+    if (m_hdbc == SQL_NULL_HDBC)
+        return SQL_INVALID_HANDLE;
+
+    if (m_bInTransaction)
+        return SQL_SUCCESS;
+
+    SQLRETURN retcode = ::SQLSetConnectAttr(m_hdbc, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER) SQL_AUTOCOMMIT_OFF, SQL_IS_UINTEGER);
+    if (!SQL_SUCCEEDED(retcode))
+        throw DbException(retcode, SQL_HANDLE_DBC, m_hdbc);
+
+    m_bInTransaction = true;
+    return retcode;
+}
+
+SQLRETURN Connection::Commit()
+{
+    return EndTransaction(SQL_COMMIT);
+}
+
+SQLRETURN Connection::Rollback()
+{
+    return EndTransaction(SQL_ROLLBACK);
+}
+
+SQLRETURN Connection::EndTransaction(SQLSMALLINT nCompletionType)
+{
+    if (m_hdbc == SQL_NULL_HDBC)
+        return SQL_INVALID_HANDLE;
+
+    if (!m_bInTransaction)
+        return SQL_SUCCESS;
+
+    SQLRETURN retcode = ::SQLEndTran(SQL_HANDLE_DBC, m_hdbc, nCompletionType);
+    if (!SQL_SUCCEEDED(retcode))
+        throw DbException(retcode, SQL_HANDLE_DBC, m_hdbc);
+
+    // back to autocommit mode, this must not be done before SQLEndTran because it would commit
+    m_bInTransaction = false;
+    SQLRETURN retcode2 = ::SQLSetConnectAttr(m_hdbc, SQL_ATTR_AUTOCOMMIT, (SQLPOINTER) SQL_AUTOCOMMIT_ON, SQL_IS_UINTEGER);
+    if (!SQL_SUCCEEDED(retcode2))
+        throw DbException(retcode2, SQL_HANDLE_DBC, m_hdbc);
+
+    return retcode;
+}
+
+void Connection::SetDescribeCacheSize(size_t nMaxEntries)
+{
+    m_nDescribeCacheSize = nMaxEntries;
+    if (m_DescribeCache.size() > m_nDescribeCacheSize)
+        m_DescribeCache.clear();
+}
+
+bool Connection::LookupDescribeCache(const tstring& statement, ResultInfo& resultinfo) const
+{
+    if (m_nDescribeCacheSize == 0)
+        return false;
+
+    auto it = m_DescribeCache.find(statement);
+    if (it == m_DescribeCache.end())
+        return false;
+
+    resultinfo = it->second;
+    return true;
+}
+
+void Connection::StoreDescribeCache(const tstring& statement, const ResultInfo& resultinfo)
+{
+    if (m_nDescribeCacheSize == 0)
+        return;
+
+    // simply start over when the cache is full
+    if (m_DescribeCache.size() >= m_nDescribeCacheSize && m_DescribeCache.find(statement) == m_DescribeCache.end())
+        m_DescribeCache.clear();
+
+    m_DescribeCache[statement] = resultinfo;
+}
+
+void Connection::SetStatementPoolSize(size_t nMaxHandles)
+{
+    m_nStatementPoolSize = nMaxHandles;
+    while (m_FreeStatements.size() > m_nStatementPoolSize)
+    {
+        ::SQLFreeHandle(SQL_HANDLE_STMT, m_FreeStatements.back());
+        m_FreeStatements.pop_back();
+    }
+}
+
+SQLRETURN Connection::AllocStatement(HSTMT& hstmt)
+{
+    if (!m_FreeStatements.empty())
+    {
+        m_nStatementPoolHits++;
+        hstmt = m_FreeStatements.back();
+        m_FreeStatements.pop_back();
+        return SQL_SUCCESS;
+    }
+
+    if (m_nStatementPoolSize > 0)
+        m_nStatementPoolMisses++;
+    return ::SQLAllocHandle(SQL_HANDLE_STMT, m_hdbc, &hstmt);
+}
+
+void Connection::FreeStatement(HSTMT hstmt)
+{
+    if (hstmt == SQL_NULL_HSTMT)
+        return;
+    if (m_hdbc != SQL_NULL_HDBC && m_FreeStatements.size() < m_nStatementPoolSize)
+        m_FreeStatements.push_back(hstmt);
+    else
+        ::SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+}
+
+void Connection::SetStatementCacheSize(size_t nMaxEntries)
+{
+    m_nStatementCacheSize = nMaxEntries;
+    while (m_StatementCache.size() > m_nStatementCacheSize)
+    {
+        FreeStatement(m_StatementCache.back().second.m_hstmt);
+        m_StatementIndex.erase(m_StatementCache.back().first);
+        m_StatementCache.pop_back();
+    }
+}
+
+void Connection::ClearStatementCache()
+{
+    for (auto& entry : m_StatementCache)
+        FreeStatement(entry.second.m_hstmt);
+    m_StatementCache.clear();
+    m_StatementIndex.clear();
+}
+
+bool Connection::CheckOutStatement(const tstring& statement, PreparedStatement& entry)
+{
+    if (m_nStatementCacheSize == 0)
+        return false;
+
+    auto it = m_StatementIndex.find(statement);
+    if (it == m_StatementIndex.end())
+    {
+        m_nStatementCacheMisses++;
+        return false;
+    }
+
+    m_nStatementCacheHits++;
+    entry = std::move(it->second->second);
+    m_StatementCache.erase(it->second);
+    m_StatementIndex.erase(it);
+    return true;
+}
+
+void Connection::ReturnStatement(const tstring& statement, PreparedStatement& entry)
+{
+    if (m_nStatementCacheSize == 0 || m_hdbc == SQL_NULL_HDBC
+        || m_StatementIndex.find(statement) != m_StatementIndex.end())
+    {
+        FreeStatement(entry.m_hstmt);
+        entry.m_hstmt = SQL_NULL_HSTMT;
+        return;
+    }
+
+    m_StatementCache.emplace_front(statement, std::move(entry));
+    m_StatementIndex[statement] = m_StatementCache.begin();
+    entry.m_hstmt = SQL_NULL_HSTMT;
+    // evict the least recently used statement
+    SetStatementCacheSize(m_nStatementCacheSize);
 }
 
 SQLRETURN Connection::SqlGetInfo(SQLUSMALLINT InfoType, tstring& info) const
@@ -158,3 +386,47 @@ SQLRETURN Connection::SqlGetInfo(SQLUSMALLINT InfoType, tstring& info) const
 
     return nRetCode;
 }
+
+Transaction::Transaction(Connection& connection)
+    : m_Connection(connection)
+{
+    m_bActive = false;
+    // a guard inside a transaction which is already open leaves commit and rollback to its owner
+    if (m_Connection.IsInTransaction())
+        return;
+    m_Connection.BeginTransaction();
+    m_bActive = true;
+}
+
+Transaction::~Transaction()
+{
+    if (!m_bActive)
+        return;
+
+    // must not throw from a destructor
+    try
+    {
+        m_Connection.Rollback();
+    }
+    catch (...)
+    {
+    }
+}
+
+SQLRETURN Transaction::Commit()
+{
+    if (!m_bActive)
+        return SQL_SUCCESS;
+
+    m_bActive = false;
+    return m_Connection.Commit();
+}
+
+SQLRETURN Transaction::Rollback()
+{
+    if (!m_bActive)
+        return SQL_SUCCESS;
+
+    m_bActive = false;
+    return m_Connection.Rollback();
+}
@@ -5,6 +5,13 @@
 #include <sql.h>
 #include <sqlext.h>
 #include "odbcexception.h"
+#include "resultinfo.h"
+#include "paraminfo.h"
+#include <map>
+#include <mutex>
+#include <list>
+#include <unordered_map>
+#include <vector>
 
 namespace linguversa
 {
@@ -19,6 +26,14 @@ public:
     bool Open(std::tstring& connectionstring, HWND hWnd, SQLUSMALLINT driverCompletion = SQL_DRIVER_COMPLETE);
     bool IsOpen() const;
     void Close();
+    // Asks the driver whether the connection to the server has been lost (SQL_ATTR_CONNECTION_DEAD).
+    // Drivers which do not support this attribute are assumed to be alive.
+    bool IsDead() const;
+
+    // Let the driver manager pool the physical connections, e.g. SQL_CP_ONE_PER_HENV or SQL_CP_ONE_PER_DRIVER,
+    // SQL_CP_OFF to switch it off. Must be called before the first Connection is created, otherwise
+    // SQL_ERROR is returned. (unixODBC additionally requires Pooling=Yes in odbcinst.ini.)
+    static SQLRETURN SetDriverManagerPooling(SQLUINTEGER nPooling = SQL_CP_ONE_PER_HENV);
     
     // valid InfoTypes are:
     // SQL_DATA_SOURCE_NAME, SQL_DATABASE_NAME, SQL_USER_NAME, SQL_DBMS_NAME, SQL_DBMS_VER, 
@@ -29,13 +44,121 @@ public:
     SQLRETURN SqlGetDriverVersion(std::tstring& sDriverVersion) const
         { return SqlGetInfo(SQL_DRIVER_VER, sDriverVersion); };
     
+    // Switch off autocommit mode, so that all subsequent statements belong to one transaction
+    // until Commit() or Rollback(), which switch autocommit mode on again.
+    SQLRETURN BeginTransaction();
+    SQLRETURN Commit();
+    SQLRETURN Rollback();
+    bool IsInTransaction() const { return m_bInTransaction; };
+
+    // Default timeout in seconds (SQL_ATTR_QUERY_TIMEOUT) for the statements of all queries on this connection,
+    // unless set by Query::SetQueryTimeout(). 0 (the default) means no timeout.
+    void SetQueryTimeout(SQLULEN nSeconds) { m_nQueryTimeout = nSeconds; };
+    SQLULEN GetQueryTimeout() const { return m_nQueryTimeout; };
+
     HENV GetSqlHEnv() const { return m_henv;};
     HDBC GetSqlHDbc() const { return m_hdbc;};
 
+    // The describe cache remembers the result columns of up to nMaxEntries statement texts,
+    // so that executing the same statement again does not need SQLDescribeCol for every column.
+    // 0 (the default) disables the cache. Only enable it if the schema does not change while
+    // the connection is open, or call ClearDescribeCache() after DDL statements.
+    void SetDescribeCacheSize(size_t nMaxEntries);
+    size_t GetDescribeCacheSize() const { return m_nDescribeCacheSize; };
+    void ClearDescribeCache() { m_DescribeCache.clear(); };
+
+    bool LookupDescribeCache(const std::tstring& statement, ResultInfo& resultinfo) const;
+    void StoreDescribeCache(const std::tstring& statement, const ResultInfo& resultinfo);
+
+    // The statement cache keeps up to nMaxEntries prepared statement handles, keyed by statement text,
+    // together with the descriptions of their parameters and result columns. Query::Prepare() checks a
+    // handle out of the cache instead of calling SQLPrepare and SQLDescribeParam again, Query::Close()
+    // returns it. The least recently returned statement is freed when the cache is full.
+    // 0 (the default) disables the cache. As with the describe cache, call ClearStatementCache()
+    // after DDL statements.
+    void SetStatementCacheSize(size_t nMaxEntries);
+    size_t GetStatementCacheSize() const { return m_nStatementCacheSize; };
+    void ClearStatementCache();
+    size_t GetStatementCacheHits() const { return m_nStatementCacheHits; };
+    size_t GetStatementCacheMisses() const { return m_nStatementCacheMisses; };
+
+    // The statement pool keeps up to nMaxHandles statement handles which have been reset by Query::Close(),
+    // so that the next query on this connection needs no SQLAllocHandle. 0 (the default) disables the pool.
+    void SetStatementPoolSize(size_t nMaxHandles);
+    size_t GetStatementPoolSize() const { return m_nStatementPoolSize; };
+    size_t GetFreeStatementCount() const { return m_FreeStatements.size(); };
+    size_t GetStatementPoolHits() const { return m_nStatementPoolHits; };
+    size_t GetStatementPoolMisses() const { return m_nStatementPoolMisses; };
+    // Take a handle from the pool or allocate a new one.
+    SQLRETURN AllocStatement(HSTMT& hstmt);
+    // Put a handle back into the pool or free it if the pool is full. The handle must not have an open
+    // cursor, bound columns or parameters, or attributes pointing to memory of the caller.
+    void FreeStatement(HSTMT hstmt);
+
+    // A prepared statement handle that is not in use, and what Query::Prepare() found out about it.
+    struct PreparedStatement
+    {
+        HSTMT m_hstmt = SQL_NULL_HSTMT;
+        std::vector<ParamInfo> m_Params;    // 1-based like the parameter numbers, m_Params[0] is unused
+        ResultInfo m_ResultInfo;            // columns of the first result set
+        bool m_bResultInfo = false;         // false if the statement has not been executed yet
+    };
+    // Remove the entry of statement from the cache; false if there is none.
+    bool CheckOutStatement(const std::tstring& statement, PreparedStatement& entry);
+    // Put the entry back as the most recently used one. If the cache already has an entry for
+    // statement (checked out by another query in the meantime) or is disabled, the handle is freed.
+    void ReturnStatement(const std::tstring& statement, PreparedStatement& entry);
+
 protected:
+    // shared by all connections; m_EnvMutex guards m_henv and m_ConnectionCounter,
+    // so that connections can be opened and closed from several threads
     static HENV m_henv;
     static int m_ConnectionCounter;
+    static std::mutex m_EnvMutex;
     HDBC m_hdbc;
+    bool m_bInTransaction;
+    SQLULEN m_nQueryTimeout;
+
+    SQLRETURN EndTransaction(SQLSMALLINT nCompletionType);
+
+    std::map<std::tstring, ResultInfo> m_DescribeCache;
+    size_t m_nDescribeCacheSize;
+
+    // most recently used first
+    typedef std::list<std::pair<std::tstring, PreparedStatement>> StatementList;
+    StatementList m_StatementCache;
+    std::unordered_map<std::tstring, StatementList::iterator> m_StatementIndex;
+    size_t m_nStatementCacheSize;
+    size_t m_nStatementCacheHits;
+    size_t m_nStatementCacheMisses;
+
+    std::vector<HSTMT> m_FreeStatements;
+    size_t m_nStatementPoolSize;
+    size_t m_nStatementPoolHits;
+    size_t m_nStatementPoolMisses;
+};
+
+// Rolls back the transaction on destruction unless Commit() has been called, e.g.
+//     Transaction trans(con);
+//     query.ExecDirect(...);   // may throw
+//     trans.Commit();
+// If the connection is already in a transaction, the guard did not start it and Commit(),
+// Rollback() and the destructor do nothing; IsActive() is false then.
+class Transaction
+{
+public:
+    Transaction(Connection& connection);
+    ~Transaction();
+    Transaction(const Transaction&) = delete;
+    Transaction& operator = (const Transaction&) = delete;
+
+    SQLRETURN Commit();
+    SQLRETURN Rollback();
+    bool IsActive() const { return m_bActive; };
+
+protected:
+    Connection& m_Connection;
+    bool m_bActive;
 };
 
 }
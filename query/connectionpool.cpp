@@ -0,0 +1,144 @@
+#include "connectionpool.h"
+#include <cassert>
+#include <chrono>
+
+using namespace linguversa;
+using namespace std;
+
+ConnectionPool::ConnectionPool(tstring connectionstring, size_t nMinSize, size_t nMaxSize)
+{
+    m_strConnection = connectionstring;
+    m_nMaxSize = (nMaxSize > 0) ? nMaxSize : 1;
+    m_nMinSize = (nMinSize < m_nMaxSize) ? nMinSize : m_nMaxSize;
+    m_nOpen = 0;
+}
+
+ConnectionPool::~ConnectionPool()
+{
+    lock_guard<mutex> lock(m_Mutex);
+    // all connections should have been returned by now
+    assert(m_Idle.size() == m_nOpen);
+    for (size_t i = 0; i < m_Idle.size(); i++)
+        delete m_Idle[i];
+    m_Idle.clear();
+    m_nOpen = 0;
+}
+
+size_t ConnectionPool::WarmUp()
+{
+    while (true)
+    {
+        {
+            lock_guard<mutex> lock(m_Mutex);
+            if (m_nOpen >= m_nMinSize)
+                return m_nOpen;
+            m_nOpen++;  // reserve the place before connecting without the lock
+        }
+
+        Connection* pConnection = OpenConnection();
+
+        lock_guard<mutex> lock(m_Mutex);
+        m_Idle.push_back(pConnection);
+        m_Available.notify_one();
+    }
+}
+
+Connection* ConnectionPool::Checkout(unsigned long nTimeoutMs)
+{
+    {
+        unique_lock<mutex> lock(m_Mutex);
+        auto bAvailable = [this] { return !m_Idle.empty() || m_nOpen < m_nMaxSize; };
+        if (nTimeoutMs == WaitForever)
+            m_Available.wait(lock, bAvailable);
+        else if (!m_Available.wait_for(lock, chrono::milliseconds(nTimeoutMs), bAvailable))
+            return nullptr;
+
+        if (!m_Idle.empty())
+        {
+            // the most recently used connection is the least likely to have timed out
+            Connection* pConnection = m_Idle.back();
+            m_Idle.pop_back();
+            return pConnection;
+        }
+
+        m_nOpen++;
+    }
+
+    return OpenConnection();
+}
+
+void ConnectionPool::Return(Connection* pConnection)
+{
+    if (pConnection == nullptr)
+        return;
+
+    bool bValid = Validate(pConnection);
+    if (!bValid)
+        delete pConnection;
+
+    lock_guard<mutex> lock(m_Mutex);
+    if (bValid)
+        m_Idle.push_back(pConnection);
+    else
+        m_nOpen--;
+    m_Available.notify_one();
+}
+
+size_t ConnectionPool::GetSize() const
+{
+    lock_guard<mutex> lock(m_Mutex);
+    return m_nOpen;
+}
+
+size_t ConnectionPool::GetIdleCount() const
+{
+    lock_guard<mutex> lock(m_Mutex);
+    return m_Idle.size();
+}
+
+// Called with a place reserved in m_nOpen, which is given back if the connection cannot be opened.
+Connection* ConnectionPool::OpenConnection()
+{
+    Connection* pConnection = nullptr;
+    try
+    {
+        pConnection = new Connection();
+        // Open() throws with the driver's diagnostics if the connect fails. It returns false without
+        // an environment or if the completed connection string did not fit; report what the handles know.
+        if (!pConnection->Open(m_strConnection))
+        {
+            if (pConnection->GetSqlHDbc() != SQL_NULL_HDBC)
+                throw DbException(SQL_ERROR, SQL_HANDLE_DBC, pConnection->GetSqlHDbc());
+            throw DbException(SQL_ERROR, SQL_HANDLE_ENV, pConnection->GetSqlHEnv());
+        }
+    }
+    catch (...)
+    {
+        delete pConnection;
+        lock_guard<mutex> lock(m_Mutex);
+        m_nOpen--;
+        m_Available.notify_one();
+        throw;
+    }
+
+    return pConnection;
+}
+
+bool ConnectionPool::Validate(Connection* pConnection)
+{
+    if (!pConnection->IsOpen() || pConnection->IsDead())
+        return false;
+
+    try
+    {
+        // the next user must not inherit uncommitted work
+        if (pConnection->IsInTransaction())
+            pConnection->Rollback();
+    }
+    catch (DbException&)
+    {
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "tstring.h"
+#include "connection.h"
+
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+namespace linguversa
+{
+    // A set of open connections with the same connection string, shared by several threads.
+    // Checkout() hands out an idle connection or opens a new one as long as there are less than
+    // nMaxSize, otherwise it waits until another thread returns one.
+    // Each connection is used by one thread at a time; the pool itself is thread safe.
+    class ConnectionPool
+    {
+    public:
+        static const unsigned long WaitForever = (unsigned long) -1;
+
+        ConnectionPool(std::tstring connectionstring, size_t nMinSize = 1, size_t nMaxSize = 8);
+        ~ConnectionPool();
+        ConnectionPool(const ConnectionPool&) = delete;
+        ConnectionPool& operator = (const ConnectionPool&) = delete;
+
+        // Open connections until there are at least nMinSize, so that the first queries do not have to wait
+        // for SQLDriverConnect. Returns the number of open connections.
+        size_t WarmUp();
+
+        // Returns an open connection, or nullptr if none became available within nTimeoutMs milliseconds.
+        // Throws DbException if a new connection cannot be opened.
+        Connection* Checkout(unsigned long nTimeoutMs = WaitForever);
+        // Give a connection back to the pool. An open transaction is rolled back; a connection
+        // which fails or which the driver reports as dead is closed and replaced on demand.
+        void Return(Connection* pConnection);
+
+        size_t GetMinSize() const { return m_nMinSize; };
+        size_t GetMaxSize() const { return m_nMaxSize; };
+        // number of open connections, idle or checked out
+        size_t GetSize() const;
+        size_t GetIdleCount() const;
+
+    protected:
+        std::tstring m_strConnection;
+        size_t m_nMinSize;
+        size_t m_nMaxSize;
+
+        mutable std::mutex m_Mutex;
+        std::condition_variable m_Available;
+        std::vector<Connection*> m_Idle;
+        size_t m_nOpen;     // idle + checked out + being opened
+
+        Connection* OpenConnection();
+        bool Validate(Connection* pConnection);
+    };
+
+    // Checks out a connection for the lifetime of the object:
+    //     PooledConnection con(pool);
+    //     Query query(*con);
+    class PooledConnection
+    {
+    public:
+        PooledConnection(ConnectionPool& pool, unsigned long nTimeoutMs = ConnectionPool::WaitForever)
+            : m_Pool(pool) { m_pConnection = pool.Checkout(nTimeoutMs); };
+        ~PooledConnection() { if (m_pConnection) m_Pool.Return(m_pConnection); };
+        PooledConnection(const PooledConnection&) = delete;
+        PooledConnection& operator = (const PooledConnection&) = delete;
+
+        // false if Checkout() has timed out
+        bool IsValid() const { return m_pConnection != nullptr; };
+        Connection& operator*() const { return *m_pConnection; };
+        Connection* operator->() const { return m_pConnection; };
+        Connection* Get() const { return m_pConnection; };
+
+    protected:
+        ConnectionPool& m_Pool;
+        Connection* m_pConnection;
+    };
+}
@@ -10,16 +10,33 @@ namespace linguversa
 class DataRow : public std::vector<DBItem>
 {
 public:
-    //LwDataRow();
-    //LwDataRow( const LwDataRow& src);
-    //const LwDataRow& operator = ( const LwDataRow& src);
+    DataRow() : m_pResource(nullptr) {};
+    // The items of the row allocate long values from pResource, see DBItem::SetMemoryResource().
+    explicit DataRow( MemoryResource* pResource) : m_pResource(pResource) {};
+    // Copies use new/delete, like copies of a DBItem.
+    DataRow( const DataRow& src) : std::vector<DBItem>(src), m_pResource(nullptr) {};
+    DataRow( DataRow&& src) = default;
+    // Keeps the resource of the target, also for the items added by the assignment.
+    DataRow& operator = ( const DataRow& src);
+    DataRow& operator = ( DataRow&& src) = default;
     //bool operator == (const LwDataRow& other) const;
     //bool operator != (const LwDataRow& other) const;
 
+    void swap( DataRow& other) noexcept { std::vector<DBItem>::swap(other); std::swap(m_pResource, other.m_pResource); };
+
+    // Set all items to null but keep their buffers for the next row.
+    void reset();
+
+    // Set the allocator of all items, including those added later by resize().
+    void SetMemoryResource( MemoryResource* pResource);
+    MemoryResource* GetMemoryResource() const { return m_pResource; };
+    void resize( size_type nCount);
+
     std::tstring Format( const ResultInfo& resultinfo, const std::tstring fmt = _T("")) const;
 
 protected:
     //ResultInfo* m_pResultInfo;
+    MemoryResource* m_pResource;
 };
 
 }
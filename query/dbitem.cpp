@@ -1,6 +1,15 @@
 #include "dbitem.h"
 #include "lvstring.h"
+#include "columnformatter.h"
 #include <cassert>
+#include <cstring>
+#include <utility>
+#include <cmath>
+#if ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L) && defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
 
 using namespace std;
 using namespace linguversa;
@@ -8,16 +17,31 @@ using namespace linguversa;
 DBItem::DBItem()
 {
     m_nVarType = lwvt_null;
-    m_pstring = nullptr;
+    m_pHeap = nullptr;
+    m_nHeapSize = 0;
+    m_nDataLen = 0;
+    m_pResource = nullptr;
+    memset(m_Inline, 0, sizeof(m_Inline));
+}
+
+DBItem::DBItem( MemoryResource* pResource)
+    : DBItem()
+{
+    m_pResource = pResource;
 }
 
 DBItem::DBItem( const DBItem& src)
+    : DBItem()
 {
-    m_nVarType = lwvt_null;
-    m_pstring = nullptr;
     copyfrom( src);
 }
 
+DBItem::DBItem( DBItem&& src) noexcept
+    : DBItem()
+{
+    swap( src);
+}
+
 DBItem::~DBItem()
 {
     clear();
@@ -25,55 +49,188 @@ DBItem::~DBItem()
 
 void DBItem::clear()
 {
-    switch (m_nVarType)
+    // All values except the long ones are inline, so only the heap buffer has to be released.
+    FreeHeap();
+    m_nDataLen = 0;
+    memset(m_Inline, 0, sizeof(m_Inline));
+    m_nVarType = lwvt_null;
+}
+
+void DBItem::reset()
+{
+    m_nDataLen = 0;
+    memset(m_Inline, 0, sizeof(m_Inline));
+    m_nVarType = lwvt_null;
+}
+
+void DBItem::swap( DBItem& other) noexcept
+{
+    std::swap(m_nVarType, other.m_nVarType);
+    std::swap(m_Inline, other.m_Inline);    // the whole union
+    std::swap(m_pHeap, other.m_pHeap);
+    std::swap(m_nHeapSize, other.m_nHeapSize);
+    std::swap(m_nDataLen, other.m_nDataLen);
+    std::swap(m_pResource, other.m_pResource);
+}
+
+void DBItem::SetMemoryResource( MemoryResource* pResource)
+{
+    if (pResource == m_pResource)
+        return;
+
+    // keep the value, but move it out of the old buffer
+    DBItem tmp( pResource);
+    tmp.copyfrom( *this);
+    swap( tmp);
+}
+
+unsigned char* DBItem::AllocateHeap( size_t nSize)
+{
+    if (m_pResource)
+        return (unsigned char*) m_pResource->allocate(nSize, alignof(wchar_t));
+    return new unsigned char[nSize];
+}
+
+void DBItem::FreeHeap()
+{
+    if (m_pHeap)
     {
-    case lwvt_string:
-        if (m_pstring)
-            delete (tstring*) m_pstring;
-        m_pstring = nullptr;
-        m_nVarType = lwvt_null;
-        break;
-    case lwvt_astring:
-        if (m_pstringw)
-            delete (wstring*) m_pstringw;
-        m_pstringw = nullptr;
-        m_nVarType = lwvt_null;
-        break;
-    case lwvt_wstring:
-        if (m_pstringa)
-            delete (string*) m_pstringa;
-        m_pstringa = nullptr;
-        m_nVarType = lwvt_null;
-        break;
-    case lwvt_date:
-        if (m_pdate)
-            delete (TIMESTAMP_STRUCT*) m_pdate;
-        m_pdate = nullptr;
-        m_nVarType = lwvt_null;
-        break;
-    case lwvt_bytearray:
-        if (m_pByteArray)
-            delete (bytearray*) m_pByteArray;
-        m_pByteArray = nullptr;
-        m_nVarType = lwvt_null;
-        break;
-    case lwvt_uint64:
-        if (m_pUInt64)
-            delete (unsigned ODBCINT64*) m_pUInt64;
-        m_pUInt64 = nullptr;
-        m_nVarType = lwvt_null;
-        break;
-    case lwvt_guid:
-        if (m_pGUID)
-            delete (SQLGUID*) m_pGUID;
-        m_pGUID = nullptr;
-        m_nVarType = lwvt_null;
-        break;
-    default: // The other parts of the union are no pointers.
-        // No explicit delete necessary.
-        m_lVal = 0L;
-        m_nVarType = lwvt_null;
+        if (m_pResource)
+            m_pResource->deallocate(m_pHeap, m_nHeapSize, alignof(wchar_t));
+        else
+            delete[] m_pHeap;
+    }
+    m_pHeap = nullptr;
+    m_nHeapSize = 0;
+}
+
+bool DBItem::IsVarLength( vartype type)
+{
+    return type == lwvt_string || type == lwvt_astring || type == lwvt_wstring || type == lwvt_bytearray;
+}
+
+unsigned char* DBItem::ResizeData( vartype type, size_t nBytes)
+{
+    assert(IsVarLength(type));
+    if (!IsVarLength(m_nVarType))
+        m_nDataLen = 0;     // the union holds no variable length data
+
+    const size_t nTerm = sizeof(wchar_t);   // room for the terminating zero of any character type
+    size_t nKeep = (m_nDataLen < nBytes) ? m_nDataLen : nBytes;
+    bool bOldInline = IsInline();
+    if (nBytes + nTerm <= sizeof(m_Inline))
+    {
+        if (!bOldInline)
+            memmove(m_Inline, m_pHeap, nKeep);
+    }
+    else if (m_nHeapSize < nBytes + nTerm)
+    {
+        size_t nSize = (2 * m_nHeapSize > nBytes + nTerm) ? 2 * m_nHeapSize : nBytes + nTerm;
+        unsigned char* pHeap = AllocateHeap(nSize);
+        if (nKeep > 0)
+            memcpy(pHeap, bOldInline ? m_Inline : m_pHeap, nKeep);
+        FreeHeap();
+        m_pHeap = pHeap;
+        m_nHeapSize = nSize;
     }
+    else if (bOldInline && nKeep > 0)
+    {
+        memcpy(m_pHeap, m_Inline, nKeep);
+    }
+
+    m_nVarType = type;
+    m_nDataLen = nBytes;
+    unsigned char* pBuf = GetBuffer();
+    memset(pBuf + nBytes, 0, nTerm);
+    return pBuf;
+}
+
+const TCHAR* DBItem::GetString() const
+{
+    if (m_nVarType != lwvt_string)
+        return _T("");
+    return (const TCHAR*) GetBuffer();
+}
+
+const char* DBItem::GetStringA() const
+{
+    #ifdef UNICODE
+    if (m_nVarType != lwvt_astring)
+    #else
+    if (m_nVarType != lwvt_string && m_nVarType != lwvt_astring)
+    #endif
+        return "";
+    return (const char*) GetBuffer();
+}
+
+const wchar_t* DBItem::GetStringW() const
+{
+    #ifdef UNICODE
+    if (m_nVarType != lwvt_string && m_nVarType != lwvt_wstring)
+    #else
+    if (m_nVarType != lwvt_wstring)
+    #endif
+        return L"";
+    return (const wchar_t*) GetBuffer();
+}
+
+const unsigned char* DBItem::GetData() const
+{
+    return IsVarLength(m_nVarType) ? GetBuffer() : nullptr;
+}
+
+size_t DBItem::GetDataLength() const
+{
+    return IsVarLength(m_nVarType) ? m_nDataLen : 0;
+}
+
+bytearray DBItem::GetByteArray() const
+{
+    if (m_nVarType != lwvt_bytearray)
+        return bytearray();
+    const unsigned char* p = GetBuffer();
+    return bytearray(p, p + m_nDataLen);
+}
+
+void DBItem::SetString( const tstring& s)
+{
+    SetString( s.data(), s.size());
+}
+
+void DBItem::SetString( const TCHAR* s, size_t len)
+{
+    unsigned char* pBuf = ResizeData(lwvt_string, len * sizeof(TCHAR));
+    if (len > 0)
+        memcpy(pBuf, s, len * sizeof(TCHAR));
+}
+
+void DBItem::SetStringA( const char* s, size_t len)
+{
+    #ifdef UNICODE
+    unsigned char* pBuf = ResizeData(lwvt_astring, len);
+    #else
+    unsigned char* pBuf = ResizeData(lwvt_string, len);
+    #endif
+    if (len > 0)
+        memcpy(pBuf, s, len);
+}
+
+void DBItem::SetStringW( const wchar_t* s, size_t len)
+{
+    #ifdef UNICODE
+    unsigned char* pBuf = ResizeData(lwvt_string, len * sizeof(wchar_t));
+    #else
+    unsigned char* pBuf = ResizeData(lwvt_wstring, len * sizeof(wchar_t));
+    #endif
+    if (len > 0)
+        memcpy(pBuf, s, len * sizeof(wchar_t));
+}
+
+void DBItem::SetByteArray( const unsigned char* p, size_t len)
+{
+    unsigned char* pBuf = ResizeData(lwvt_bytearray, len);
+    if (len > 0)
+        memcpy(pBuf, p, len);
 }
 
 DBItem& DBItem::operator = ( const DBItem& src)
@@ -82,6 +239,22 @@ DBItem& DBItem::operator = ( const DBItem& src)
     return *this;
 }
 
+DBItem& DBItem::operator = ( DBItem&& src) noexcept
+{
+    if (this == &src)
+        return *this;
+
+    // the buffer can only be taken over if it comes from the same allocator
+    if (m_pResource == src.m_pResource)
+    {
+        clear();
+        swap( src);
+    }
+    else
+        copyfrom( src);
+    return *this;
+}
+
 bool DBItem::operator==(const DBItem & other) const
 {
     if (m_nVarType != other.m_nVarType)
@@ -100,48 +273,36 @@ bool DBItem::operator==(const DBItem & other) const
     case lwvt_double:
         return m_dblVal == other.m_dblVal;
     case lwvt_string:
-        return *m_pstring == *other.m_pstring;
+    case lwvt_astring:
+    case lwvt_wstring:
+    case lwvt_bytearray:
+        return m_nDataLen == other.m_nDataLen && memcmp(GetBuffer(), other.GetBuffer(), m_nDataLen) == 0;
     case lwvt_date:
         return
-            m_pdate != nullptr && other.m_pdate != nullptr &&
-            m_pdate->year == other.m_pdate->year &&
-            m_pdate->month == other.m_pdate->month &&
-            m_pdate->day == other.m_pdate->day &&
-            m_pdate->hour == other.m_pdate->hour &&
-            m_pdate->minute == other.m_pdate->minute &&
-            m_pdate->second == other.m_pdate->second &&
-            m_pdate->fraction == other.m_pdate->fraction;
-    case lwvt_bytearray:
-        if (m_pByteArray == nullptr || other.m_pByteArray == nullptr || m_pByteArray->size() != other.m_pByteArray->size())
-            return false;
-        for (unsigned int i = 0; i < m_pByteArray->size(); i++)
-        {
-            if ((*m_pByteArray)[i] != (*other.m_pByteArray)[i])
-                return false;
-        }
-        return true;
+            m_dateVal.year == other.m_dateVal.year &&
+            m_dateVal.month == other.m_dateVal.month &&
+            m_dateVal.day == other.m_dateVal.day &&
+            m_dateVal.hour == other.m_dateVal.hour &&
+            m_dateVal.minute == other.m_dateVal.minute &&
+            m_dateVal.second == other.m_dateVal.second &&
+            m_dateVal.fraction == other.m_dateVal.fraction;
     case lwvt_uint64:
-        return
-            m_pUInt64 != nullptr && other.m_pUInt64 != nullptr &&
-            *m_pUInt64 == *other.m_pUInt64;
+        return m_ui64Val == other.m_ui64Val;
     case lwvt_guid:
         // in windows it works this way:
-        //     return 
-        //m_pGUID != nullptr && other.m_pGUID != nullptr &&
-        //*m_pGUID == *other.m_pGUID;
+        //     return m_guidVal == other.m_guidVal;
 
         // but unfortunately we have to implement it explicitly
-        if (m_pGUID == nullptr || other.m_pGUID == nullptr ||
-            m_pGUID->Data1 != other.m_pGUID->Data1 ||
-            m_pGUID->Data2 != other.m_pGUID->Data2 ||
-            m_pGUID->Data3 != other.m_pGUID->Data3)
+        if (m_guidVal.Data1 != other.m_guidVal.Data1 ||
+            m_guidVal.Data2 != other.m_guidVal.Data2 ||
+            m_guidVal.Data3 != other.m_guidVal.Data3)
         {
             return false;
         }
         
         for (int i = 0; i < 8; i++)
         {
-            if (m_pGUID->Data4[i] != other.m_pGUID->Data4[i])
+            if (m_guidVal.Data4[i] != other.m_guidVal.Data4[i])
                 return false;
         }
         
@@ -151,145 +312,113 @@ bool DBItem::operator==(const DBItem & other) const
     }
 }
 
-TCHAR ConvertNationalDecSeparator( tstring& DecimalFormat)
+tstring DBItem::ConvertToString( const DBItem& var, tstring colFmt)
 {
-    size_t n = 0;
-    TCHAR ret;
-    if ((n = DecimalFormat.find(_T(','), 0)) != tstring::npos && DecimalFormat.find(_T(','), n + 1) == tstring::npos)
-    {
-        ret = DecimalFormat[n];
-        DecimalFormat[n] = _T('.');
-        return ret;
-    }
-
-    return _T('\0');
+    return ColumnFormatter( colFmt).Format( var);
 }
 
-tstring DBItem::ConvertToString( const DBItem& var, tstring colFmt)
+DBItem::NumberFormat::NumberFormat( const tstring& fmt)
+    : NumberFormat()
 {
-    tstring sValue;
-    TCHAR cNationalDecSep = 0;
-    tstring DecimalFormat;
-    tstring NullDefault;
+    // exactly one conversion without width, i.e. % [0] [.precision] [l|ll] conversion
+    size_t n = fmt.length();
+    size_t i = 0;
+    if (i >= n || fmt[i++] != _T('%'))
+        return;
+    if (i < n && fmt[i] == _T('0'))
+        i++;
 
-    // get the Default for NULL value, empty string if not specified
-    size_t nPos = colFmt.find( _T("|"));
-    if (nPos != tstring::npos)
+    int nPrecision = -1;
+    if (i < n && fmt[i] == _T('.'))
     {
-        NullDefault = (nPos+1 < colFmt.size()) ? colFmt.substr(nPos+1) : _T("");
-        colFmt = colFmt.substr(0,nPos);
+        nPrecision = 0;
+        for (i++; i < n && fmt[i] >= _T('0') && fmt[i] <= _T('9') && nPrecision < 100; i++)
+            nPrecision = 10 * nPrecision + (fmt[i] - _T('0'));
     }
 
-    // format var according to its type
-    switch (var.m_nVarType)
+    while (i < n && fmt[i] == _T('l'))
+        i++;
+    if (i + 1 != n)
+        return;
+
+    switch (fmt[i])
     {
-    case lwvt_bool:
-        if (colFmt.length() == 0)
-            colFmt = _T("%0d");
-        sValue = linguversa::string_format( colFmt, (unsigned char) var.m_boolVal);
-        break;
-    case lwvt_uchar:
-        if (colFmt.length() == 0)
-            colFmt = _T("%0d");
-        sValue = linguversa::string_format( colFmt, var.m_chVal);
-        break;
-    case lwvt_short:
-        if (colFmt.length() == 0)
-            colFmt = _T("%0d");
-        sValue = linguversa::string_format( colFmt, var.m_iVal);
-        break;
-    case lwvt_long:
-        if (colFmt.length() == 0)
-            colFmt = _T("%0d");
-        sValue = linguversa::string_format( colFmt, var.m_lVal);
-        break;
-    case lwvt_single:
-        DecimalFormat = colFmt;
-        cNationalDecSep = ::ConvertNationalDecSeparator( DecimalFormat);
-        if (DecimalFormat.length() == 0)
-            DecimalFormat = _T("%0.3f");
-        sValue = linguversa::string_format( DecimalFormat, var.m_fltVal);
-        if (cNationalDecSep && (nPos = sValue.find(_T('.'), 0)) != tstring::npos)
-            sValue[nPos] = cNationalDecSep;
-        break;
-    case lwvt_double: 
-        DecimalFormat = colFmt;
-        cNationalDecSep = ::ConvertNationalDecSeparator( DecimalFormat);
-        if (DecimalFormat.length() == 0)
-            DecimalFormat = _T("%0.6f");
-        sValue = linguversa::string_format( DecimalFormat, var.m_dblVal);
-        if (cNationalDecSep && (nPos = sValue.find(_T('.'), 0)) != tstring::npos)
-            sValue[nPos] = cNationalDecSep;
-        break;
-    case lwvt_date:
-        sValue = linguversa::FormatTimeStamp( colFmt, var.m_pdate);
-        break;
-    case lwvt_string:
-        if (var.m_pstring && !(colFmt.length() == 0) && colFmt.find(_T('%')) != tstring::npos)
-            sValue = string_format(colFmt, var.m_pstring->c_str());
-        else
-            sValue = var.m_pstring ? *(var.m_pstring) : _T(""); // StrLenFormat(var.m_pstring ? var.m_pstring->c_str() : _T(""), colFmt);
-        break;
-    #ifdef UNICODE
-    case lwvt_wstring:
+    case _T('d'):
+    case _T('i'):
+    case _T('u'):
+        if (nPrecision < 0)
         {
-            wstring str = var.m_pstringw ? *(var.m_pstringw) : L"";
-            if (!(colFmt.length() == 0) && colFmt.find('%') != wstring::npos)
-                sValue = string_format(colFmt, str.c_str());
-            else
-                sValue = str; //StrLenFormat(str, colFmt);
+            m_nKind = integer;
+            m_bUnsigned = (fmt[i] == _T('u'));
         }
         break;
-    #else
-    case lwvt_astring:
-        {
-            string str = var.m_pstringa ? *(var.m_pstringa) : "";
-            if (!(colFmt.length() == 0) && colFmt.find('%') != string::npos)
-                sValue = string_format(colFmt, str.c_str());
-            else
-                sValue = str; //StrLenFormat(str, colFmt);
-        }
+    case _T('f'):
+        m_nKind = fixed;
+        m_nPrecision = (nPrecision >= 0) ? nPrecision : 6;
         break;
-    #endif
-
-    case lwvt_bytearray:
-        if (var.m_pByteArray == nullptr)
-            break;
-        else
-        {
-            bytearray& ba = *var.m_pByteArray;
-            tstring s;
-            sValue = ba.size() ? _T("0x") : _T("");;
-            for (unsigned int i = 0; i < ba.size(); i++)
-            {
-                s = string_format(_T("%02x"), ba[i]);
-                sValue += s;
-            }
-        }
-        break;
-    case lwvt_uint64:
-        if (colFmt.length() == 0)
-            colFmt = _T("%0d");
-        sValue = string_format( colFmt, *var.m_pUInt64);
-        break;
-    case lwvt_guid:
-        if (var.m_pGUID)
-        {
-            SQLGUID& g = *var.m_pGUID;
-            sValue = string_format( _T("%08lx-%04x-%04x-%02x%02x-%02x%02x%02x%02x%02x%02x\n"), 
-                g.Data1, g.Data2, g.Data3, 
-                g.Data4[0], g.Data4[1], g.Data4[2], g.Data4[3], g.Data4[4], g.Data4[5], g.Data4[6], g.Data4[7]);
-        }
-        break;
-    case lwvt_null:
-        sValue = NullDefault;
+    case _T('g'):
+        m_nKind = general;
+        m_nPrecision = (nPrecision > 0) ? nPrecision : (nPrecision == 0) ? 1 : 6;
         break;
     default:
-        sValue = _T("<undefined>");
         break;
     }
+}
+
+bool DBItem::NumberFormat::Format( long long nValue, tstring& s) const
+{
+#ifdef __cpp_lib_to_chars
+    if (m_nKind == integer && !(m_bUnsigned && nValue < 0))
+    {
+        char buf[24];
+        std::to_chars_result res = std::to_chars( buf, buf + sizeof(buf), nValue);
+        s.assign( buf, res.ptr);    // digits are ASCII, also in UNICODE builds
+        return true;
+    }
+#else
+    (void) nValue;
+    (void) s;
+#endif
+    return false;
+}
+
+bool DBItem::NumberFormat::Format( unsigned long long nValue, tstring& s) const
+{
+#ifdef __cpp_lib_to_chars
+    if (m_nKind == integer)
+    {
+        char buf[24];
+        std::to_chars_result res = std::to_chars( buf, buf + sizeof(buf), nValue);
+        s.assign( buf, res.ptr);
+        return true;
+    }
+#else
+    (void) nValue;
+    (void) s;
+#endif
+    return false;
+}
 
-    return sValue;
+bool DBItem::NumberFormat::Format( double dValue, tstring& s) const
+{
+#ifdef __cpp_lib_to_chars
+    // printf spells nan and inf differently on different platforms
+    if ((m_nKind == fixed || m_nKind == general) && std::isfinite( dValue))
+    {
+        char buf[448];
+        std::to_chars_result res = std::to_chars( buf, buf + sizeof(buf), dValue,
+            (m_nKind == fixed) ? std::chars_format::fixed : std::chars_format::general, m_nPrecision);
+        if (res.ec == std::errc())
+        {
+            s.assign( buf, res.ptr);
+            return true;
+        }
+    }
+#else
+    (void) dValue;
+    (void) s;
+#endif
+    return false;
 }
 
 void DBItem::copyfrom(const DBItem& src)
@@ -299,7 +428,7 @@ void DBItem::copyfrom(const DBItem& src)
 
     if (m_nVarType != src.m_nVarType)
     {
-        clear();
+        reset();    // keep the buffer
     }
     
     switch (src.m_nVarType)
@@ -330,59 +459,27 @@ void DBItem::copyfrom(const DBItem& src)
         m_nVarType = src.m_nVarType;
         m_dblVal = src.m_dblVal;
         break;
-    case lwvt_string:
-        if (m_nVarType != src.m_nVarType)
-        {
-            m_pstring = new tstring(*src.m_pstring);
-            m_nVarType = src.m_nVarType;
-        }
-        else
-        {
-            *m_pstring = *src.m_pstring;
-        }
-        break;
     case lwvt_date:
-        if (m_nVarType != src.m_nVarType)
-        {
-            m_pdate = new TIMESTAMP_STRUCT;
-            m_nVarType = src.m_nVarType;
-        }
-        m_pdate->year = src.m_pdate ? src.m_pdate->year : 0;
-        m_pdate->month = src.m_pdate ? src.m_pdate->month : 0;
-        m_pdate->day = src.m_pdate ? src.m_pdate->day : 0;
-        m_pdate->hour = src.m_pdate ? src.m_pdate->hour : 0;
-        m_pdate->minute = src.m_pdate ? src.m_pdate->minute : 0;
-        m_pdate->second = src.m_pdate ? src.m_pdate->second : 0;
-        m_pdate->fraction = src.m_pdate ? src.m_pdate->fraction : 0;
-        break;
-    case lwvt_bytearray:
-        if (m_nVarType != src.m_nVarType)
-        {
-            m_pByteArray = new bytearray();
-            m_nVarType = src.m_nVarType;
-        }
-        m_pByteArray->resize(src.m_pByteArray->size());
-        for (unsigned int i=0; i < m_pByteArray->size(); i++)
-        {
-            (*m_pByteArray)[i] = (*src.m_pByteArray)[i];
-        }
+        m_nVarType = src.m_nVarType;
+        m_dateVal = src.m_dateVal;
         break;
     case lwvt_uint64:
-        if (m_nVarType != src.m_nVarType)
-        {
-            m_pUInt64 = new unsigned ODBCINT64;
-            m_nVarType = src.m_nVarType;
-        }
-        *m_pUInt64 = *src.m_pUInt64;
+        m_nVarType = src.m_nVarType;
+        m_ui64Val = src.m_ui64Val;
         break;
     case lwvt_guid:
-        if (m_nVarType != src.m_nVarType)
-        {
-            m_pGUID = new SQLGUID;
-            m_nVarType = src.m_nVarType;
-        }
-        *m_pGUID = *src.m_pGUID;
+        m_nVarType = src.m_nVarType;
+        m_guidVal = src.m_guidVal;
         break;
+    case lwvt_string:
+    case lwvt_astring:
+    case lwvt_wstring:
+    case lwvt_bytearray:
+    {
+        unsigned char* pBuf = ResizeData(src.m_nVarType, src.m_nDataLen);
+        if (src.m_nDataLen > 0)
+            memcpy(pBuf, src.GetBuffer(), src.m_nDataLen);
+    } break;
     default:
         assert( false);
         clear();
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "tstring.h"
+#include "memoryresource.h"
 
 #include <sql.h>
 #include <sqlext.h>
@@ -14,7 +15,11 @@ namespace linguversa
     {
     public:
         DBItem();
+        // Long strings and byte arrays are allocated from pResource instead of the global heap.
+        // The resource must outlive the item.
+        explicit DBItem( MemoryResource* pResource);
         DBItem( const DBItem& src);
+        DBItem( DBItem&& src) noexcept;
         virtual ~DBItem();
 
         typedef enum {
@@ -35,13 +40,21 @@ namespace linguversa
             lwvt_guid = 27,   // LWVT_GUID   = 27,
         } vartype;
         
+        // Set to lwvt_null and release the heap buffer.
         void clear();
+        // Set to lwvt_null but keep the heap buffer, so that the next value of the same size or smaller
+        // does not allocate again. Used to recycle the items of a DataRow from row to row.
+        void reset();
         DBItem& operator = ( const DBItem& src);
+        DBItem& operator = ( DBItem&& src) noexcept;
+        void swap( DBItem& other) noexcept;
 
         bool operator == (const DBItem& other) const;
 
         vartype m_nVarType;
         
+        // All fixed size types are stored inline. Strings and byte arrays are stored in m_Inline if they are short,
+        // otherwise in a heap buffer; use the accessors below for them.
         union
         {
           bool              m_boolVal;
@@ -50,18 +63,78 @@ namespace linguversa
           long              m_lVal;     // SQL_C_LONG      = SQL_INTEGER := 4    /* INTEGER       */
           float             m_fltVal;   // SQL_C_FLOAT     = SQL_REAL := 7       /* REAL          */
           double            m_dblVal;   // SQL_C_DOUBLE    = SQL_DOUBLE := 8     /* FLOAT, DOUBLE */
-          TIMESTAMP_STRUCT* m_pdate;    // SQL_C_TIMESTAMP = SQL_TIMESTAMP := 11 /* DATETIME      */
-          std::tstring*     m_pstring;  // SQL_C_TCHAR     = SQL_CHAR := 1       /* CHAR, VARCHAR */
-          std::string*      m_pstringa; // SQL_C_CHAR      = SQL_CHAR := 1       /* CHAR, VARCHAR */
-          std::wstring*     m_pstringw; // SQL_C_WCHAR     = SQL_CHAR := 1       /* CHAR, VARCHAR */
-          bytearray*        m_pByteArray; // SQL_C_BINARY  = SQL_BINARY := -2
-          unsigned ODBCINT64* m_pUInt64;  // SQL_C_UBIGINT = SQL_BIGINT + SQL_UNSIGNED_OFFSET = -27
-          SQLGUID*          m_pGUID;    // SQL_C_GUID :    = SQL_GUID = -11
+          TIMESTAMP_STRUCT  m_dateVal;  // SQL_C_TIMESTAMP = SQL_TIMESTAMP := 11 /* DATETIME      */
+          unsigned ODBCINT64 m_ui64Val; // SQL_C_UBIGINT   = SQL_BIGINT + SQL_UNSIGNED_OFFSET = -27
+          SQLGUID           m_guidVal;  // SQL_C_GUID :    = SQL_GUID = -11
+          unsigned char     m_Inline[24]; // short values of lwvt_string, lwvt_astring, lwvt_wstring, lwvt_bytearray
         };
+
+        // Variable length values: lwvt_string (SQL_C_TCHAR), lwvt_astring (SQL_C_CHAR), lwvt_wstring (SQL_C_WCHAR)
+        // and lwvt_bytearray (SQL_C_BINARY). The string accessors return a null terminated string, which is empty
+        // if the item holds a value of another type. GetDataLength() is the length in bytes without terminating zero.
+        const TCHAR* GetString() const;
+        const char* GetStringA() const;
+        const wchar_t* GetStringW() const;
+        const unsigned char* GetData() const;
+        size_t GetDataLength() const;
+        bytearray GetByteArray() const;
+
+        void SetString( const std::tstring& s);
+        void SetString( const TCHAR* s, size_t len);
+        void SetStringA( const char* s, size_t len);     // lwvt_astring, in non-UNICODE builds lwvt_string
+        void SetStringW( const wchar_t* s, size_t len);  // lwvt_wstring, in UNICODE builds lwvt_string
+        void SetByteArray( const unsigned char* p, size_t len);
+
+        // Set the type and make room for a variable length value of nBytes bytes plus a terminating zero.
+        // The returned buffer can be filled directly (e.g. by SQLGetData). The current contents are kept
+        // up to the new length, so the function can also be used to grow or shrink a value.
+        unsigned char* ResizeData( vartype type, size_t nBytes);
+
+        static bool IsVarLength( vartype type);
+
+        // Releases the current buffer and uses pResource for subsequent allocations,
+        // nullptr means new/delete. A copy constructed item uses new/delete, a move constructed item
+        // and swap() take the resource along. Assignment keeps the resource of the target and takes
+        // over the buffer of a moved item only if both use the same resource, otherwise it copies.
+        void SetMemoryResource( MemoryResource* pResource);
+        MemoryResource* GetMemoryResource() const { return m_pResource; };
         
         static std::tstring ConvertToString( const DBItem& var, std::tstring colFmt = _T(""));
 
+        // A printf-style format of a numeric value, parsed once. The common formats %d, %0d, %i, %u, %ld, %lld, ...
+        // and %f, %.Nf, %0.Nf, %g, %.Ng are written with std::to_chars into a stack buffer if the library
+        // supports it (C++17, __cpp_lib_to_chars). Format() returns false for all other formats, for values
+        // printf would print differently (e.g. nan) and without to_chars; the caller then uses snprintf.
+        class NumberFormat
+        {
+        public:
+            NumberFormat() : m_nKind(other), m_nPrecision(-1), m_bUnsigned(false) {};
+            explicit NumberFormat( const std::tstring& fmt);
+            bool Format( long long nValue, std::tstring& s) const;
+            bool Format( unsigned long long nValue, std::tstring& s) const;
+            bool Format( double dValue, std::tstring& s) const;
+            bool IsFast() const { return m_nKind != other; };
+
+        protected:
+            enum { other, integer, fixed, general } m_nKind;
+            int m_nPrecision;
+            bool m_bUnsigned;   // %u, negative values are left to snprintf
+        };
+
     protected:
+        unsigned char* m_pHeap; // buffer for values which do not fit into m_Inline
+        size_t m_nHeapSize;
+        size_t m_nDataLen;      // length of the variable length value in bytes
+        MemoryResource* m_pResource; // allocator of m_pHeap, nullptr for new[]/delete[]
+
+        unsigned char* AllocateHeap( size_t nSize);
+        void FreeHeap();
+
+        // Values are stored inline if they fit including a terminating zero of the widest character type.
+        bool IsInline() const { return m_nDataLen + sizeof(wchar_t) <= sizeof(m_Inline); };
+        unsigned char* GetBuffer() { return IsInline() ? m_Inline : m_pHeap; };
+        const unsigned char* GetBuffer() const { return IsInline() ? m_Inline : m_pHeap; };
+
         void copyfrom( const DBItem& src);
     };
 }
@@ -136,7 +136,7 @@ short FieldInfo::GetDefaultCType(const FieldInfo& fi)
     return nFieldType;
 }
 
-const short FieldInfo::GetDefaultCType()
+const short FieldInfo::GetDefaultCType() const
 {
     if (m_nCType != DEFAULT_FIELD_TYPE)    // if member explicitly set
         return m_nCType;
@@ -144,7 +144,7 @@ const short FieldInfo::GetDefaultCType()
         return FieldInfo::GetDefaultCType(*this);
 }
 
-const tstring FieldInfo::GetDefaultFormat()
+const tstring FieldInfo::GetDefaultFormat() const
 {
     tstring fmt;
     switch (m_nSQLType)
@@ -20,8 +20,8 @@ namespace linguversa
 
         void InitData();
         static short GetDefaultCType(const FieldInfo& fi);
-        const short GetDefaultCType();
-        const std::tstring GetDefaultFormat();
+        const short GetDefaultCType() const;
+        const std::tstring GetDefaultFormat() const;
 
         signed short m_nCType;
         // meta data from ODBC
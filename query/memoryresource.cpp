@@ -0,0 +1,93 @@
+#include "memoryresource.h"
+#include <cassert>
+#include <cstdint>
+#include <new>
+
+using namespace linguversa;
+using namespace std;
+
+ArenaResource::ArenaResource(size_t nBlockSize)
+{
+    m_nBlockSize = (nBlockSize > 0) ? nBlockSize : 1024;
+    m_nCurrent = 0;
+    m_nOffset = 0;
+}
+
+ArenaResource::~ArenaResource()
+{
+    Release();
+}
+
+void ArenaResource::Reset()
+{
+    m_nCurrent = 0;
+    m_nOffset = 0;
+}
+
+void ArenaResource::Release()
+{
+    for (size_t i = 0; i < m_Blocks.size(); i++)
+        ::operator delete(m_Blocks[i].m_pData);
+    m_Blocks.clear();
+    Reset();
+}
+
+size_t ArenaResource::GetUsedSize() const
+{
+    size_t nUsed = 0;
+    for (size_t i = 0; i < m_nCurrent && i < m_Blocks.size(); i++)
+        nUsed += m_Blocks[i].m_nSize;
+    return m_Blocks.empty() ? 0 : nUsed + m_nOffset;
+}
+
+size_t ArenaResource::GetCapacity() const
+{
+    size_t nCapacity = 0;
+    for (size_t i = 0; i < m_Blocks.size(); i++)
+        nCapacity += m_Blocks[i].m_nSize;
+    return nCapacity;
+}
+
+void* ArenaResource::do_allocate(size_t nBytes, size_t nAlignment)
+{
+    assert(nAlignment > 0 && (nAlignment & (nAlignment - 1)) == 0);
+    if (nAlignment < alignof(std::max_align_t))
+        nAlignment = alignof(std::max_align_t);  // ::operator new guarantees this for the block start
+
+    // Try the current block, then the following ones which were kept by Reset().
+    // (The last part of a block is wasted if the request does not fit.)
+    while (m_nCurrent < m_Blocks.size())
+    {
+        Block& block = m_Blocks[m_nCurrent];
+        size_t nStart = (m_nOffset + nAlignment - 1) & ~(nAlignment - 1);
+        if (nStart + nBytes <= block.m_nSize)
+        {
+            m_nOffset = nStart + nBytes;
+            return block.m_pData + nStart;
+        }
+        m_nCurrent++;
+        m_nOffset = 0;
+    }
+
+    // Large requests get a block of their own.
+    Block block;
+    block.m_nSize = (nBytes > m_nBlockSize) ? nBytes : m_nBlockSize;
+    block.m_pData = (unsigned char*) ::operator new(block.m_nSize);
+    m_Blocks.push_back(block);
+    m_nCurrent = m_Blocks.size() - 1;
+    m_nOffset = nBytes;
+    return block.m_pData;
+}
+
+void ArenaResource::do_deallocate(void* p, size_t nBytes, size_t nAlignment)
+{
+    // memory is reclaimed by Reset() or Release()
+    (void) p;
+    (void) nBytes;
+    (void) nAlignment;
+}
+
+bool ArenaResource::do_is_equal(const MemoryResource& other) const noexcept
+{
+    return this == &other;
+}
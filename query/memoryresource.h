@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#if ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L) && defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define LV_HAS_PMR
+#endif
+#endif
+
+namespace linguversa
+{
+#ifdef LV_HAS_PMR
+    // With C++17 any std::pmr::memory_resource (e.g. std::pmr::unsynchronized_pool_resource) can be used.
+    typedef std::pmr::memory_resource MemoryResource;
+#else
+    // Same interface as std::pmr::memory_resource, for compilers without <memory_resource>.
+    class MemoryResource
+    {
+    public:
+        virtual ~MemoryResource() {};
+
+        void* allocate(size_t nBytes, size_t nAlignment = alignof(std::max_align_t))
+            { return do_allocate(nBytes, nAlignment); };
+        void deallocate(void* p, size_t nBytes, size_t nAlignment = alignof(std::max_align_t))
+            { do_deallocate(p, nBytes, nAlignment); };
+        bool is_equal(const MemoryResource& other) const noexcept
+            { return do_is_equal(other); };
+
+    protected:
+        virtual void* do_allocate(size_t nBytes, size_t nAlignment) = 0;
+        virtual void do_deallocate(void* p, size_t nBytes, size_t nAlignment) = 0;
+        virtual bool do_is_equal(const MemoryResource& other) const noexcept = 0;
+    };
+#endif
+
+    // Monotonic arena: allocations are taken from large blocks one after the other and deallocate()
+    // does nothing. Reset() makes the whole memory available again at once but keeps the blocks,
+    // so that a sequence of rows of similar size does not allocate at all after the first one.
+    // Not thread safe; use one arena per thread (e.g. per Query).
+    class ArenaResource : public MemoryResource
+    {
+    public:
+        explicit ArenaResource(size_t nBlockSize = 64 * 1024);
+        ~ArenaResource();
+        ArenaResource(const ArenaResource&) = delete;
+        ArenaResource& operator = (const ArenaResource&) = delete;
+
+        // Invalidate all allocations, keep the blocks for reuse.
+        void Reset();
+        // Invalidate all allocations and free the blocks.
+        void Release();
+
+        // bytes currently handed out and bytes held in blocks
+        size_t GetUsedSize() const;
+        size_t GetCapacity() const;
+
+    protected:
+        virtual void* do_allocate(size_t nBytes, size_t nAlignment) override;
+        virtual void do_deallocate(void* p, size_t nBytes, size_t nAlignment) override;
+        virtual bool do_is_equal(const MemoryResource& other) const noexcept override;
+
+        struct Block
+        {
+            unsigned char* m_pData;
+            size_t m_nSize;
+        };
+        std::vector<Block> m_Blocks;
+        size_t m_nBlockSize;
+        size_t m_nCurrent;  // index of the block in use
+        size_t m_nOffset;   // first free byte in m_Blocks[m_nCurrent]
+    };
+}
@@ -17,6 +17,28 @@ DbException::DbException( SQLRETURN ret, SQLSMALLINT handleType, SQLHANDLE handl
     SQLSMALLINT msgLen;
     ::SQLGetDiagRec( handleType, handle, n, m_SqlState, &m_NativeError, m_SqlError, SQL_MAX_MESSAGE_LENGTH, &msgLen);
 
+    FormatWhat();
+}
+
+DbException::DbException( SQLRETURN ret, const TCHAR* sqlState, const TCHAR* message)
+{
+    m_SqlReturn = ret;
+    m_NativeError = 0;
+    m_what[0] = 0;
+
+    size_t i = 0;
+    for (; sqlState[i] != 0 && i < 5; i++)
+        m_SqlState[i] = (SQLTCHAR) sqlState[i];
+    m_SqlState[i] = 0;
+    for (i = 0; message[i] != 0 && i < SQL_MAX_MESSAGE_LENGTH - 1; i++)
+        m_SqlError[i] = (SQLTCHAR) message[i];
+    m_SqlError[i] = 0;
+
+    FormatWhat();
+}
+
+void DbException::FormatWhat()
+{
 #ifdef _UNICODE
     // The virtual member function what() of base class exception returns char* 
     // Thus we have to convert: 
@@ -11,6 +11,8 @@ class DbException : public std::exception
 {
 public:
     DbException( SQLRETURN ret, SQLSMALLINT handleType, SQLHANDLE handle);
+    // for errors detected by the library itself, without a diagnostic record of the driver
+    DbException( SQLRETURN ret, const TCHAR* sqlState, const TCHAR* message);
     ~DbException();
 
     virtual const char* what() const noexcept;
@@ -21,6 +23,8 @@ public:
     std::tstring getSqlErrorMessage() const;
 
 protected:
+    void FormatWhat();
+
     SQLRETURN m_SqlReturn;
     SQLTCHAR m_SqlState[8];
     SQLINTEGER m_NativeError;
@@ -21,6 +21,9 @@ ParamItem::~ParamItem()
 
 void ParamItem::Clear()
 {
+    // a buffer bound instead of a data-at-execution parameter must not keep the producer,
+    // which may refer to a stream that no longer exists
+    m_Producer = nullptr;
     if (!m_local)
         return;
     assert(m_local);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "paraminfo.h"
+#include <functional>
 
 namespace linguversa
 {
@@ -22,6 +23,9 @@ namespace linguversa
         // false: pointer m_pParam was set by BindParam()
         //        to a variable outside of Query object
         bool m_local;
+        // data-at-execution parameter: fills the buffer with the next chunk of the value
+        // and returns the number of bytes, 0 at the end of the value
+        std::function<size_t(unsigned char*, size_t)> m_Producer;
 
         ParamItem();
         ~ParamItem();
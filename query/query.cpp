@@ -1,6 +1,9 @@
 #include "query.h"
 #include "paramitem.h"
+#include "columnbinding.h"
+#include "watchdog.h"
 #include <cassert>
+#include <cstring>
 
 using namespace linguversa;
 using namespace std;
@@ -9,6 +12,15 @@ Query::Query()
 {
     m_pConnection = nullptr;
     m_hdbc = SQL_NULL_HDBC;
+    m_nRowsetSize = 1;
+    m_bFieldNameNoCase = false;
+    m_nResultSetId = 0;
+    m_nFieldCount = -1;
+    m_nAsyncMode = -1;
+    m_nQueryTimeout = -1;
+    m_bCancelled = false;
+    m_bWatched = false;
+    m_nPutDataChunkSize = 65536;
     InitData();
 }
 
@@ -16,6 +28,15 @@ Query::Query( Connection* pConnection)
 {
     m_pConnection = nullptr;
     m_hdbc = SQL_NULL_HDBC;
+    m_nRowsetSize = 1;
+    m_bFieldNameNoCase = false;
+    m_nResultSetId = 0;
+    m_nFieldCount = -1;
+    m_nAsyncMode = -1;
+    m_nQueryTimeout = -1;
+    m_bCancelled = false;
+    m_bWatched = false;
+    m_nPutDataChunkSize = 65536;
     InitData();
     SetDatabase(pConnection);
 }
@@ -29,6 +50,7 @@ Query::~Query()
 {
     try	// Do not terminate destructor by exception!
     {
+        ClearDeadline();
         if (m_hstmt)
             Close();
     }
@@ -42,6 +64,7 @@ void Query::SetDatabase( Connection* pConnection)
         Close();
         m_pConnection = pConnection;
         m_hdbc = m_pConnection ? m_pConnection->GetSqlHDbc() : SQL_NULL_HDBC;
+        m_nAsyncMode = -1;
     }
 }
 
@@ -52,12 +75,26 @@ void Query::SetDatabase(Connection& connection)
         Close();
         m_pConnection = &connection;
         m_hdbc = m_pConnection ? m_pConnection->GetSqlHDbc() : SQL_NULL_HDBC;
+        m_nAsyncMode = -1;
     }
 }
 
 SQLRETURN Query::ExecDirect( tstring statement)
+{
+    SQLRETURN nRetCode = ResetStatement();
+    if (nRetCode != SQL_SUCCESS)
+        return nRetCode;
+
+    nRetCode = ::SQLExecDirect( m_hstmt, (SQLTCHAR*) statement.c_str(), SQL_NTS);    // makro sets nRetCode
+    nRetCode = PutParamData(nRetCode);
+    return EndExecDirect(nRetCode, statement);
+}
+
+// allocate the statement handle or read behind the last result set of the previous statement
+SQLRETURN Query::ResetStatement()
 {
     SQLRETURN nRetCode = SQL_SUCCESS;    //Return code for your ODBC calls
+    m_bCancelled = false;
     if (m_hdbc == NULL && m_pConnection != nullptr)
         m_hdbc = m_pConnection->GetSqlHDbc();
     assert(m_hdbc != SQL_NULL_HDBC);
@@ -65,10 +102,17 @@ SQLRETURN Query::ExecDirect( tstring statement)
     if (m_hdbc == NULL)
         return SQL_INVALID_HANDLE;
 
+    // SQLExecDirect would replace the prepared statement of a cached handle
+    if (m_bCachedStatement)
+    {
+        ReleaseCachedStatement();
+        InitData();
+    }
+
     if (m_hstmt == NULL)
     {
         // Allocate new Statement Handle based on existing connection
-        nRetCode = ::SQLAllocHandle(SQL_HANDLE_STMT, m_hdbc, &m_hstmt);
+        nRetCode = AllocStatement();
         if (!SQL_SUCCEEDED(nRetCode) || m_hstmt == NULL)
         {
             throw DbException(nRetCode, SQL_HANDLE_DBC, m_hdbc);
@@ -87,8 +131,11 @@ SQLRETURN Query::ExecDirect( tstring statement)
             return nRetCode;
     }
 
-    nRetCode = ::SQLExecDirect( m_hstmt, (SQLTCHAR*) statement.c_str(), SQL_NTS);    // makro sets nRetCode
+    return SQL_SUCCESS;
+}
 
+SQLRETURN Query::EndExecDirect( SQLRETURN nRetCode, const tstring& statement)
+{
     // Using ODBC 3 SQLExecDirect/SQLExecute can return SQL_NO_DATA with means SQL_SUCCESS with no rows.
     // From manual:
     //    "If SQLExecDirect executes a searched update or delete statement that
@@ -101,26 +148,147 @@ SQLRETURN Query::ExecDirect( tstring statement)
         return nRetCode;
     }
 
-    RETCODE nRetCode2 = InitFieldInfos();
+    RETCODE nRetCode2 = InitFieldInfos(&statement);
     if (nRetCode2 != SQL_SUCCESS)
         return nRetCode2;
 
     return nRetCode;
 }
 
+bool Query::SupportsAsync()
+{
+    if (m_nAsyncMode < 0)
+    {
+        if (m_hdbc == NULL && m_pConnection != nullptr)
+            m_hdbc = m_pConnection->GetSqlHDbc();
+        if (m_hdbc == NULL)
+            return false;
+
+        SQLUINTEGER nAsyncMode = SQL_AM_NONE;
+        SQLRETURN nRetCode = ::SQLGetInfo(m_hdbc, SQL_ASYNC_MODE, &nAsyncMode, sizeof(nAsyncMode), nullptr);
+        m_nAsyncMode = SQL_SUCCEEDED(nRetCode) ? (int) nAsyncMode : SQL_AM_NONE;
+    }
+    return m_nAsyncMode == SQL_AM_STATEMENT;
+}
+
+SQLRETURN Query::SetAsyncEnable(bool bEnable)
+{
+    SQLRETURN nRetCode = ::SQLSetStmtAttr(m_hstmt, SQL_ATTR_ASYNC_ENABLE, 
+        (SQLPOINTER) (bEnable ? SQL_ASYNC_ENABLE_ON : SQL_ASYNC_ENABLE_OFF), SQL_IS_UINTEGER);
+    if (!SQL_SUCCEEDED(nRetCode))
+        throw DbException(nRetCode, SQL_HANDLE_STMT, m_hstmt);
+    return nRetCode;
+}
+
+AsyncResult Query::ExecDirectAsync(QueryExecutor& executor, tstring statement)
+{
+    // SQLParamData/SQLPutData of data-at-execution parameters are sent synchronously by ExecDirect()
+    bool bDataAtExec = false;
+    for (ParamItem* pPi : m_ParamItem)
+        bDataAtExec = bDataAtExec || (pPi != nullptr && pPi->m_Producer);
+
+    if (!SupportsAsync() || bDataAtExec)
+        return executor.Run([this, statement]() { return ExecDirect(statement); });
+
+    // Only SQLExecDirect runs in asynchronous mode, it is called with the same arguments
+    // until it no longer returns SQL_STILL_EXECUTING.
+    shared_ptr<bool> pStarted = make_shared<bool>(false);
+    return executor.Poll([this, statement, pStarted]() 
+    {
+        SQLRETURN nRetCode = SQL_SUCCESS;
+        if (!*pStarted)
+        {
+            nRetCode = ResetStatement();
+            if (nRetCode != SQL_SUCCESS)
+                return nRetCode;
+            SetAsyncEnable(true);
+            *pStarted = true;
+        }
+
+        nRetCode = ::SQLExecDirect( m_hstmt, (SQLTCHAR*) statement.c_str(), SQL_NTS);
+        if (nRetCode == SQL_STILL_EXECUTING)
+            return nRetCode;
+
+        if (!SQL_SUCCEEDED(nRetCode) && nRetCode != SQL_NO_DATA)
+        {
+            // read the diagnostics before SQLSetStmtAttr clears them
+            DbException ex(nRetCode, SQL_HANDLE_STMT, m_hstmt);
+            SetAsyncEnable(false);
+            throw ex;
+        }
+        SetAsyncEnable(false);
+        return EndExecDirect(nRetCode, statement);
+    });
+}
+
+AsyncResult Query::FetchAsync(QueryExecutor& executor)
+{
+    // a block cursor fetches the rowsets from Fetch() in between
+    if (!SupportsAsync() || !m_ColumnBinding.empty() || m_hstmt == SQL_NULL_HSTMT)
+        return executor.Run([this]() { return Fetch(); });
+
+    shared_ptr<bool> pStarted = make_shared<bool>(false);
+    return executor.Poll([this, pStarted]() 
+    {
+        if (!*pStarted)
+        {
+            if (m_bCancelled)
+                throw DbException( SQL_ERROR, _T("HY008"), _T("Operation canceled"));
+            ResetRowData();
+            SetAsyncEnable(true);
+            *pStarted = true;
+        }
+
+        SQLRETURN nRetCode = ::SQLFetch( m_hstmt);
+        if (nRetCode == SQL_STILL_EXECUTING)
+            return nRetCode;
+
+        if (!SQL_SUCCEEDED(nRetCode) && nRetCode != SQL_NO_DATA_FOUND)
+        {
+            DbException ex(nRetCode, SQL_HANDLE_STMT, m_hstmt);
+            SetAsyncEnable(false);
+            throw ex;
+        }
+        // the column values are read with SQLGetData in synchronous mode
+        SetAsyncEnable(false);
+        return nRetCode;
+    });
+}
+
 SQLRETURN Query::Close()
 {
     SQLRETURN nRetCode = SQL_SUCCESS;    //Return code for your ODBC calls
 
+    // the watchdog must not cancel a freed handle
+    ClearDeadline();
     if (m_hstmt == NULL)
         return nRetCode;
 
-    nRetCode = ::SQLFreeHandle(SQL_HANDLE_STMT, m_hstmt);
+    if (m_bCachedStatement)
+    {
+        // back into the statement cache of the connection
+        ReleaseCachedStatement();
+        InitData();
+        return nRetCode;
+    }
+
+    if (m_pConnection != nullptr && m_pConnection->GetStatementPoolSize() > 0
+        && m_pConnection->GetSqlHDbc() != SQL_NULL_HDBC && m_pConnection->GetSqlHDbc() == m_hdbc
+        && SQL_SUCCEEDED(DetachStatement()))
+    {
+        // the reset handle goes back into the statement pool of the connection
+        m_pConnection->FreeStatement(TakeStatementHandle());
+        InitData();
+        return nRetCode;
+    }
+
+    HSTMT hstmt = TakeStatementHandle();
+    nRetCode = ::SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
     if (!SQL_SUCCEEDED(nRetCode) &&
         // do not throw exception if db was closed earlier than query
         !(nRetCode == SQL_INVALID_HANDLE && (m_pConnection ? m_pConnection->GetSqlHDbc() : m_hdbc) == SQL_NULL_HDBC))
     {
-        throw DbException(nRetCode, SQL_HANDLE_STMT, m_hstmt);
+        throw DbException(nRetCode, SQL_HANDLE_STMT, hstmt);
         return nRetCode;
     }
 
@@ -137,36 +305,282 @@ SQLRETURN Query::GetRowsAffected(SQLLEN& nRowCount)
     return ::SQLRowCount(m_hstmt, &nRowCount);
 }
 
-SQLRETURN Query::Fetch()
+// the values of the previous row become invalid
+void Query::ResetRowData()
 {
-    SQLRETURN nRetCode = SQL_SUCCESS;    //Return code for your ODBC calls
-
-    if (m_hstmt == SQL_NULL_HSTMT)
-        return SQL_INVALID_HANDLE;
-
     int nColCnt = GetODBCFieldCount();
     m_RowFieldState.resize( nColCnt);
-
     #ifdef USE_ROWDATA
         m_RowData.resize( nColCnt);
         m_Init.resize( nColCnt);
+        // Arena buffers become invalid with Reset(), so the items must let go of them.
+        bool bArena = (m_RowData.GetMemoryResource() == &m_Arena);
     #endif
     for (int i = 0; i < nColCnt; i++)
     {
         m_RowFieldState[i] = 0;
         #ifdef USE_ROWDATA
-            m_RowData[i].clear();
+            if (bArena)
+                m_RowData[i].clear();
+            else
+                m_RowData[i].reset();
             m_Init[i] = false;
         #endif
     }
+    #ifdef USE_ROWDATA
+        if (bArena)
+            m_Arena.Reset();
+    #endif
+}
 
-    nRetCode = ::SQLFetch( m_hstmt);
-    if(!SQL_SUCCEEDED(nRetCode) && nRetCode != SQL_NO_DATA_FOUND)
+SQLRETURN Query::Fetch()
+{
+    SQLRETURN nRetCode = SQL_SUCCESS;    //Return code for your ODBC calls
+
+    if (m_hstmt == SQL_NULL_HSTMT)
+        return SQL_INVALID_HANDLE;
+
+    // SQLCancel has no effect on a statement which is not executing a function,
+    // so a cancel between two fetches would be lost without this check.
+    if (m_bCancelled)
+        throw DbException( SQL_ERROR, _T("HY008"), _T("Operation canceled"));
+
+    ResetRowData();
+
+    if (m_ColumnBinding.empty())
     {
-        throw DbException( nRetCode, SQL_HANDLE_STMT, m_hstmt );
+        nRetCode = ::SQLFetch( m_hstmt);
+        if(!SQL_SUCCEEDED(nRetCode) && nRetCode != SQL_NO_DATA_FOUND)
+        {
+            throw DbException( nRetCode, SQL_HANDLE_STMT, m_hstmt );
+            return nRetCode;
+        }
         return nRetCode;
     }
-    return nRetCode;
+
+    // block cursor: move to the next row of the rowset and
+    // fetch the next rowset only if the current one is exhausted
+    m_nRowsetPos++;
+    if (m_nRowsetPos >= m_nRowsFetched)
+    {
+        m_nRowsFetched = 0;
+        m_nRowsetPos = 0;
+        nRetCode = ::SQLFetch( m_hstmt);
+        if (nRetCode == SQL_NO_DATA_FOUND)
+            return nRetCode;
+
+        if (!SQL_SUCCEEDED(nRetCode))
+        {
+            throw DbException( nRetCode, SQL_HANDLE_STMT, m_hstmt );
+            return nRetCode;
+        }
+    }
+
+    if (m_RowStatus[m_nRowsetPos] == SQL_ROW_ERROR)
+        throw DbException( SQL_ERROR, SQL_HANDLE_STMT, m_hstmt );
+
+    if (m_bSetPos)
+    {
+        // SQLGetData for the unbound columns refers to the current cursor position
+        nRetCode = ::SQLSetPos( m_hstmt, (SQLSETPOSIROW) (m_nRowsetPos + 1), SQL_POSITION, SQL_LOCK_NO_CHANGE);
+        if (!SQL_SUCCEEDED(nRetCode))
+        {
+            throw DbException( nRetCode, SQL_HANDLE_STMT, m_hstmt );
+            return nRetCode;
+        }
+    }
+
+    return SQL_SUCCESS;
+}
+
+size_t Query::FetchBatch(ColumnBatch& batch, size_t nMaxRows)
+{
+    // Always take over the column names and types of the current result set,
+    // Init() keeps the buffers of the column vectors anyway.
+    batch.Init(m_FieldInfo);
+
+    size_t nRows = 0;
+    while (nRows < nMaxRows)
+    {
+        SQLRETURN nRetCode = Fetch();
+        if (!SQL_SUCCEEDED(nRetCode))
+            break;  // SQL_NO_DATA_FOUND
+
+        for (short col = 0; col < (short) batch.m_Columns.size(); col++)
+            FetchBatchValue(col, batch.m_Columns[col]);
+        nRows++;
+    }
+
+    batch.m_nRows = nRows;
+    return nRows;
+}
+
+void Query::FetchBatchValue(short nIndex, ColumnVector& cv)
+{
+    ColumnBinding* pBinding = ((unsigned short) nIndex < m_ColumnBinding.size()) ? m_ColumnBinding[nIndex] : nullptr;
+    if (pBinding != nullptr)
+    {
+        // copy from the bound rowset buffer
+        if (pBinding->m_LenInd[m_nRowsetPos] == SQL_NULL_DATA)
+        {
+            cv.AppendNull();
+            return;
+        }
+
+        const unsigned char* pElement = pBinding->GetElement(m_nRowsetPos);
+        switch (pBinding->m_nCType)
+        {
+        case SQL_C_BIT:
+        case SQL_C_UTINYINT:
+            cv.m_Int32.push_back(*pElement);
+            break;
+        case SQL_C_SHORT:
+        {
+            SQLSMALLINT sValue;
+            memcpy(&sValue, pElement, sizeof(sValue));
+            cv.m_Int32.push_back(sValue);
+        } break;
+        case SQL_C_LONG:
+        {
+            SQLINTEGER lValue;
+            memcpy(&lValue, pElement, sizeof(lValue));
+            cv.m_Int32.push_back(lValue);
+        } break;
+        case SQL_C_FLOAT:
+        {
+            SQLREAL fValue;
+            memcpy(&fValue, pElement, sizeof(fValue));
+            cv.m_Double.push_back(fValue);
+        } break;
+        case SQL_C_DOUBLE:
+        {
+            SQLDOUBLE dValue;
+            memcpy(&dValue, pElement, sizeof(dValue));
+            cv.m_Double.push_back(dValue);
+        } break;
+        case SQL_C_TIMESTAMP:
+        {
+            TIMESTAMP_STRUCT tsValue;
+            memcpy(&tsValue, pElement, sizeof(tsValue));
+            cv.m_Timestamp.push_back(tsValue);
+        } break;
+        case SQL_C_UBIGINT:
+        {
+            SQLBIGINT biValue;
+            memcpy(&biValue, pElement, sizeof(biValue));
+            cv.m_Int64.push_back(biValue);
+        } break;
+        case SQL_C_GUID:
+            cv.m_Data.insert(cv.m_Data.end(), pElement, pElement + sizeof(SQLGUID));
+            break;
+        default:
+            assert(false);
+        }
+        cv.AppendRow(true);
+        return;
+    }
+
+    SQLLEN len = 0;
+    SQLRETURN nRetCode = SQL_SUCCESS;
+    SQLSMALLINT nCType = ColumnVector::GetCType(cv.GetType());
+    switch (cv.GetType())
+    {
+    case ColumnVector::cv_int32:
+    {
+        SQLINTEGER lValue = 0;
+        nRetCode = ::SQLGetData(m_hstmt, nIndex + 1, nCType, &lValue, sizeof(lValue), &len);
+        cv.m_Int32.push_back(lValue);
+    } break;
+
+    case ColumnVector::cv_int64:
+    {
+        SQLBIGINT biValue = 0;
+        nRetCode = ::SQLGetData(m_hstmt, nIndex + 1, nCType, &biValue, sizeof(biValue), &len);
+        cv.m_Int64.push_back(biValue);
+    } break;
+
+    case ColumnVector::cv_double:
+    {
+        SQLDOUBLE dValue = 0;
+        nRetCode = ::SQLGetData(m_hstmt, nIndex + 1, nCType, &dValue, sizeof(dValue), &len);
+        cv.m_Double.push_back(dValue);
+    } break;
+
+    case ColumnVector::cv_timestamp:
+    {
+        TIMESTAMP_STRUCT tsValue;
+        memset(&tsValue, 0, sizeof(tsValue));
+        nRetCode = ::SQLGetData(m_hstmt, nIndex + 1, nCType, &tsValue, sizeof(tsValue), &len);
+        cv.m_Timestamp.push_back(tsValue);
+    } break;
+
+    default:    // cv_string, cv_binary: read directly into the data buffer of the column
+        if (cv.GetType() == ColumnVector::cv_binary && FieldInfo::GetDefaultCType(m_FieldInfo[nIndex]) == SQL_C_GUID)
+        {
+            // as SQLGUID like the bound buffers, ExecuteBatch() relies on this layout
+            SQLGUID guid;
+            memset(&guid, 0, sizeof(guid));
+            nRetCode = ::SQLGetData(m_hstmt, nIndex + 1, SQL_C_GUID, &guid, sizeof(guid), &len);
+            if (SQL_SUCCEEDED(nRetCode) && len != SQL_NULL_DATA)
+                cv.m_Data.insert(cv.m_Data.end(), (const unsigned char*) &guid, (const unsigned char*) &guid + sizeof(guid));
+            break;
+        }
+    {
+        // the driver appends a terminating zero to character data, but not to binary data
+        size_t nTerm = (cv.GetType() == ColumnVector::cv_string) ? sizeof(TCHAR) : 0;
+        size_t nStart = cv.m_Data.size();
+        nRetCode = GetLongData(nIndex, nCType, nTerm, cv.m_Data, nStart, len);
+        cv.m_Data.resize(nStart + ((SQL_SUCCEEDED(nRetCode) && len > 0) ? len : 0));
+    } break;
+    }
+
+    if (!SQL_SUCCEEDED(nRetCode))
+        throw DbException(nRetCode, SQL_HANDLE_STMT, m_hstmt);
+
+    // SQL_NULL_DATA is -1: negative len can indicate NULL values
+    if (len == SQL_NULL_DATA)
+        cv.AppendRow(false);
+    else
+        cv.AppendRow(true);
+}
+
+SQLRETURN Query::GetLongData(short nIndex, SQLSMALLINT nCType, size_t nTerm, bytearray& buf, size_t nStart, SQLLEN& len)
+{
+    SQLRETURN nRetCode = SQL_SUCCESS;
+    size_t nUsed = 0;
+
+    // Guess the size from the column size, but use the whole buffer if it is larger anyway.
+    SQLULEN nPrecision = m_FieldInfo[nIndex].m_nPrecision;
+    size_t nBufLen = ((nPrecision > 0 && nPrecision < 4096) ? nPrecision : 4096) * (nTerm > 0 ? nTerm : 1) + nTerm;
+    if (buf.size() > nStart + nBufLen)
+        nBufLen = buf.size() - nStart;
+
+    for (;;)
+    {
+        if (buf.size() < nStart + nUsed + nBufLen)
+            buf.resize(nStart + nUsed + nBufLen);
+
+        nRetCode = ::SQLGetData(m_hstmt, nIndex + 1, nCType, &buf[nStart + nUsed], nBufLen, &len);
+        if (!SQL_SUCCEEDED(nRetCode) || len == SQL_NULL_DATA)
+            return nRetCode;
+
+        if (nRetCode == SQL_SUCCESS_WITH_INFO && (len == SQL_NO_TOTAL || (size_t) len + nTerm > nBufLen))
+        {
+            // data truncated (01004): the buffer is filled except for the terminating zero,
+            // get the rest with the next call
+            nUsed += nBufLen - nTerm;
+            nBufLen = (len == SQL_NO_TOTAL) ? 2 * nBufLen : (size_t) len - (nBufLen - nTerm) + nTerm;
+            continue;
+        }
+
+        len = (SQLLEN) (nUsed + len);
+        return nRetCode;
+    }
+}
+
+void Query::SetRowsetSize(SQLULEN nRowsetSize)
+{
+    m_nRowsetSize = (nRowsetSize > 1) ? nRowsetSize : 1;
 }
 
 RETCODE Query::SQLMoreResults()
@@ -184,6 +598,8 @@ RETCODE Query::SQLMoreResults()
     }
 
     m_RowFieldState.clear();
+    UnbindRowset();
+    m_nFieldCount = -1;
 
 #ifdef USE_ROWDATA
     int nColCnt = (int) m_RowData.size();
@@ -204,7 +620,13 @@ RETCODE Query::SQLMoreResults()
     }
 
     if (nRetCode == SQL_NO_DATA_FOUND)
+    {
+        m_FieldInfo.clear();
+        m_FieldInfo.BuildIndex(m_bFieldNameNoCase);
+        m_nResultSetId++;
+        m_nFieldCount = 0;
         return nRetCode;
+    }
 
     RETCODE nRetCode2 = InitFieldInfos();
     if (!SQL_SUCCEEDED( nRetCode2))
@@ -214,14 +636,137 @@ RETCODE Query::SQLMoreResults()
 }
 
 // Shutdown pending query for CDatabase's private m_hstmt
-void Query::Cancel()
+SQLRETURN Query::Cancel()
 {
-    if (m_hstmt != SQL_NULL_HSTMT && SQL_SUCCEEDED(::SQLCancel(m_hstmt)))
-        m_hstmt = SQL_NULL_HSTMT;
+    // The handle stays valid: the function executing on it returns SQL_ERROR (HY008).
+    // On a statement which is not executing a function SQLCancel has no effect (ODBC 3.x),
+    // the next Fetch() or FetchBatch() fails with HY008 because of m_bCancelled instead.
+    // The lock keeps the owning thread from handing the handle to the statement cache or pool
+    // of the connection (or freeing it) while SQLCancel is running, see TakeStatementHandle().
+    lock_guard<mutex> lock(m_HandleMutex);
+    if (m_hstmt == SQL_NULL_HSTMT)
+        return SQL_INVALID_HANDLE;
+    m_bCancelled = true;
+    return ::SQLCancel(m_hstmt);
+}
+
+void Query::SetStatementHandle(HSTMT hstmt)
+{
+    lock_guard<mutex> lock(m_HandleMutex);
+    m_hstmt = hstmt;
+}
+
+HSTMT Query::TakeStatementHandle()
+{
+    lock_guard<mutex> lock(m_HandleMutex);
+    HSTMT hstmt = m_hstmt;
+    m_hstmt = SQL_NULL_HSTMT;
+    return hstmt;
+}
+
+SQLRETURN Query::AllocStatement()
+{
+    // borrow a handle from the statement pool of the connection, if there is one
+    HSTMT hstmt = SQL_NULL_HSTMT;
+    SQLRETURN nRetCode = (m_pConnection != nullptr && m_pConnection->GetSqlHDbc() == m_hdbc)
+        ? m_pConnection->AllocStatement(hstmt)
+        : ::SQLAllocHandle(SQL_HANDLE_STMT, m_hdbc, &hstmt);
+    SetStatementHandle(SQL_SUCCEEDED(nRetCode) ? hstmt : SQL_NULL_HSTMT);
+    if (!SQL_SUCCEEDED(nRetCode) || m_hstmt == NULL)
+        return nRetCode;
+
+    ApplyQueryTimeout();
+    return nRetCode;
+}
+
+void Query::ApplyQueryTimeout()
+{
+    SQLULEN nTimeout = (m_nQueryTimeout >= 0) ? (SQLULEN) m_nQueryTimeout 
+        : (m_pConnection ? m_pConnection->GetQueryTimeout() : 0);
+    // Not all drivers support SQL_ATTR_QUERY_TIMEOUT; the watchdog of SetDeadline() still works then.
+    if (nTimeout > 0)
+        ::SQLSetStmtAttr(m_hstmt, SQL_ATTR_QUERY_TIMEOUT, (SQLPOINTER) nTimeout, SQL_IS_UINTEGER);
+}
+
+SQLRETURN Query::DetachStatement()
+{
+    SQLRETURN nRetCode = ::SQLFreeStmt(m_hstmt, SQL_CLOSE);
+    if (SQL_SUCCEEDED(nRetCode))
+        nRetCode = ::SQLFreeStmt(m_hstmt, SQL_UNBIND);
+    if (SQL_SUCCEEDED(nRetCode))
+        nRetCode = ::SQLFreeStmt(m_hstmt, SQL_RESET_PARAMS);
+    if (!SQL_SUCCEEDED(nRetCode))
+        return nRetCode;
+    UnbindRowset();
+
+    // the driver must not write into the arrays of this query any more
+    if (!m_RowStatus.empty())
+    {
+        ::SQLSetStmtAttr(m_hstmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER) 1, 0);
+        ::SQLSetStmtAttr(m_hstmt, SQL_ATTR_ROW_STATUS_PTR, NULL, 0);
+        ::SQLSetStmtAttr(m_hstmt, SQL_ATTR_ROWS_FETCHED_PTR, NULL, 0);
+    }
+    if (m_nParamsetSize > 1)
+    {
+        ::SQLSetStmtAttr(m_hstmt, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER) 1, 0);
+        ::SQLSetStmtAttr(m_hstmt, SQL_ATTR_PARAM_STATUS_PTR, NULL, 0);
+        ::SQLSetStmtAttr(m_hstmt, SQL_ATTR_PARAMS_PROCESSED_PTR, NULL, 0);
+    }
+    SQLULEN nTimeout = (m_nQueryTimeout >= 0) ? (SQLULEN) m_nQueryTimeout 
+        : (m_pConnection ? m_pConnection->GetQueryTimeout() : 0);
+    if (nTimeout > 0)
+        ::SQLSetStmtAttr(m_hstmt, SQL_ATTR_QUERY_TIMEOUT, (SQLPOINTER) 0, SQL_IS_UINTEGER);
+
+    return nRetCode;
+}
+
+void Query::ReleaseCachedStatement()
+{
+    m_bCachedStatement = false;
+    if (m_hstmt == NULL)
+        return;
+
+    // Without connection the handle has been freed together with it.
+    bool bReturn = m_pConnection != nullptr && m_pConnection->GetSqlHDbc() != SQL_NULL_HDBC
+        && SQL_SUCCEEDED(DetachStatement());
+    HSTMT hstmt = TakeStatementHandle();
+    if (bReturn)
+    {
+        m_Prepared.m_hstmt = hstmt;
+        m_pConnection->ReturnStatement(m_strStatement, m_Prepared);
+    }
+    else
+        ::SQLFreeHandle(SQL_HANDLE_STMT, hstmt);
+    m_Prepared = Connection::PreparedStatement();
+}
+
+void Query::SetQueryTimeout(SQLULEN nSeconds)
+{
+    m_nQueryTimeout = (long) nSeconds;
+    if (m_hstmt != SQL_NULL_HSTMT)
+        ::SQLSetStmtAttr(m_hstmt, SQL_ATTR_QUERY_TIMEOUT, (SQLPOINTER) nSeconds, SQL_IS_UINTEGER);
+}
+
+void Query::SetDeadline(std::chrono::steady_clock::time_point deadline)
+{
+    m_bCancelled = false;
+    m_bWatched = true;
+    Watchdog::GetInstance().Watch(this, deadline);
+}
+
+void Query::ClearDeadline()
+{
+    if (!m_bWatched)
+        return;
+    Watchdog::GetInstance().Unwatch(this);
+    m_bWatched = false;
 }
 
 short Query::GetODBCFieldCount() const
 {
+    if (m_nFieldCount >= 0)
+        return m_nFieldCount;
+
     SQLSMALLINT colcount = 0;
 
     SQLRETURN nRetCode = SQL_SUCCESS;    //Return code for your ODBC calls
@@ -240,15 +785,10 @@ int Query::GetFieldIndexByName(tstring lpszFieldName) const
     if (lpszFieldName.empty())
         return SQL_ERROR;
 
-    int nIndex;
-    for (nIndex = 0; nIndex < GetODBCFieldCount(); nIndex++)
-    {
-        if (m_FieldInfo[nIndex].m_strName == lpszFieldName)
-            break;
-    }
+    int nIndex = m_FieldInfo.GetSqlColumn(lpszFieldName);
 
     // Check if field name found
-    if (nIndex < 0 || nIndex >= GetODBCFieldCount())
+    if (nIndex < 0)
     {
         return SQL_ERROR;    // AFX_SQL_ERROR_FIELD_NOT_FOUND
     }
@@ -256,6 +796,31 @@ int Query::GetFieldIndexByName(tstring lpszFieldName) const
     return nIndex;
 }
 
+void Query::SetFieldNameNoCase(bool bNoCase)
+{
+    m_bFieldNameNoCase = bNoCase;
+    m_FieldInfo.BuildIndex(m_bFieldNameNoCase);
+    m_nResultSetId++;
+}
+
+ColumnHandle::ColumnHandle(const Query& query, tstring lpszFieldName)
+    : m_pQuery(&query), m_strName(lpszFieldName)
+{
+    m_nResultSetId = query.m_nResultSetId;
+    m_nIndex = (short) query.GetFieldIndexByName(m_strName);
+}
+
+short ColumnHandle::GetIndex() const
+{
+    // resolve again only if the query has moved on to another result set
+    if (m_nResultSetId != m_pQuery->m_nResultSetId)
+    {
+        m_nIndex = (short) m_pQuery->GetFieldIndexByName(m_strName);
+        m_nResultSetId = m_pQuery->m_nResultSetId;
+    }
+    return m_nIndex;
+}
+
 void Query::GetODBCFieldInfo(short nIndex, FieldInfo& fieldinfo) const
 {
     if (nIndex < 0 || (unsigned int) nIndex >= m_FieldInfo.size())
@@ -301,11 +866,20 @@ void Query::SetODBCFieldInfo(short nIndex, const FieldInfo & fieldinfo)
         return;
     }
 
+    bool bRename = (m_FieldInfo[nIndex].m_strName != fieldinfo.m_strName);
     m_FieldInfo[nIndex].m_strName = fieldinfo.m_strName;
     m_FieldInfo[nIndex].m_nSQLType = fieldinfo.m_nSQLType;
     m_FieldInfo[nIndex].m_nPrecision = fieldinfo.m_nPrecision;
     m_FieldInfo[nIndex].m_nScale = fieldinfo.m_nScale;
     m_FieldInfo[nIndex].m_nNullability = fieldinfo.m_nNullability;
+
+    if (bRename)
+    {
+        m_FieldInfo.BuildIndex(m_bFieldNameNoCase);
+        m_nResultSetId++;
+    }
+    // the formats depend on sql type, precision and scale
+    BuildColumnFormats();
 }
 
 bool Query::SetODBCFieldInfo(tstring lpszName, const FieldInfo& fieldinfo)
@@ -333,6 +907,7 @@ void Query::SetColumnSqlType(short nIndex, SWORD nSQLType)
     if (nIndex < 0 || (unsigned int) nIndex >= m_FieldInfo.size())
         throw DbException(SQL_ERROR, SQL_HANDLE_STMT, m_hstmt); // AFX_SQ_ERROR_FIELD_NOT_FOUND
     m_FieldInfo[nIndex].m_nSQLType = nSQLType;
+    BuildColumnFormats();
     return;
 }
 
@@ -342,6 +917,7 @@ bool Query::SetColumnSqlType(tstring lpszName, SWORD nSQLType)
     if (nIndex < 0)
         return false;
     m_FieldInfo[nIndex].m_nSQLType = nSQLType;
+    BuildColumnFormats();
     return true;
 }
 
@@ -371,19 +947,18 @@ bool Query::GetFieldValue(short nIndex, string& sValue)
         throw DbException( SQL_ERROR, SQL_HANDLE_STMT, m_hstmt); // AFX_SQL_ERROR_FIELD_NOT_FOUND
     }
 
-    DBItem dbitem;
-    GetFieldValue(nIndex, dbitem, SQL_C_CHAR);
+    const DBItem& dbitem = GetRowItem(nIndex, SQL_C_CHAR);
     #ifndef UNICODE
     if (dbitem.m_nVarType == DBItem::lwvt_string)
     {
-        sValue = *dbitem.m_pstringa;
+        sValue.assign(dbitem.GetStringA(), dbitem.GetDataLength());
         return true;
     }
     #endif
 
     if (dbitem.m_nVarType == DBItem::lwvt_astring)
     {
-        sValue = *dbitem.m_pstringa;
+        sValue.assign(dbitem.GetStringA(), dbitem.GetDataLength());
         return true;
     }
 
@@ -397,19 +972,18 @@ bool Query::GetFieldValue(short nIndex, wstring& sValue)
         throw DbException( SQL_ERROR, SQL_HANDLE_STMT, m_hstmt); // AFX_SQL_ERROR_FIELD_NOT_FOUND
     }
 
-    DBItem dbitem;
-    GetFieldValue(nIndex, dbitem, SQL_C_WCHAR);
+    const DBItem& dbitem = GetRowItem(nIndex, SQL_C_WCHAR);
     #ifdef UNICODE
     if (dbitem.m_nVarType == DBItem::lwvt_string)
     {
-        sValue = *dbitem.m_pstringw;
+        sValue.assign(dbitem.GetStringW(), dbitem.GetDataLength() / sizeof(wchar_t));
         return true;
     }
     #endif
 
     if (dbitem.m_nVarType == DBItem::lwvt_wstring)
     {
-        sValue = *dbitem.m_pstringw;
+        sValue.assign(dbitem.GetStringW(), dbitem.GetDataLength() / sizeof(wchar_t));
         return true;
     }
 
@@ -575,8 +1149,7 @@ bool Query::GetFieldValue(short nIndex, long & lValue)
         throw DbException(SQL_ERROR, SQL_HANDLE_STMT, m_hstmt); // AFX_SQL_ERROR_FIELD_NOT_FOUND
     }
 
-    DBItem dbitem;
-    GetFieldValue(nIndex, dbitem, SQL_C_LONG);
+    const DBItem& dbitem = GetRowItem(nIndex, SQL_C_LONG);
     switch (dbitem.m_nVarType)
     {
     case DBItem::lwvt_long:
@@ -596,8 +1169,7 @@ bool Query::GetFieldValue(short nIndex, int & iValue)
         throw DbException(SQL_ERROR, SQL_HANDLE_STMT, m_hstmt); // AFX_SQL_ERROR_FIELD_NOT_FOUND
     }
 
-    DBItem dbitem;
-    GetFieldValue(nIndex, dbitem, SQL_C_LONG);
+    const DBItem& dbitem = GetRowItem(nIndex, SQL_C_LONG);
     switch (dbitem.m_nVarType)
     {
     case DBItem::lwvt_long:
@@ -617,8 +1189,7 @@ bool Query::GetFieldValue(short nIndex, short & siValue)
         throw DbException(SQL_ERROR, SQL_HANDLE_STMT, m_hstmt); // AFX_SQL_ERROR_FIELD_NOT_FOUND
     }
 
-    DBItem dbitem;
-    GetFieldValue(nIndex, dbitem, SQL_C_SHORT);
+    const DBItem& dbitem = GetRowItem(nIndex, SQL_C_SHORT);
     switch (dbitem.m_nVarType)
     {
     case DBItem::lwvt_short:
@@ -638,12 +1209,11 @@ bool Query::GetFieldValue(short nIndex, bytearray & ba)
         throw DbException(SQL_ERROR, SQL_HANDLE_STMT, m_hstmt); // AFX_SQL_ERROR_FIELD_NOT_FOUND
     }
 
-    DBItem dbitem;
-    GetFieldValue(nIndex, dbitem, SQL_C_BINARY);
+    const DBItem& dbitem = GetRowItem(nIndex, SQL_C_BINARY);
     switch (dbitem.m_nVarType)
     {
     case DBItem::lwvt_bytearray:
-        ba = *dbitem.m_pByteArray;
+        ba = dbitem.GetByteArray();
         return true;
     default:
         return false;
@@ -659,12 +1229,11 @@ bool Query::GetFieldValue(short nIndex, unsigned ODBCINT64 & ui64Value)
         throw DbException(SQL_ERROR, SQL_HANDLE_STMT, m_hstmt); // AFX_SQL_ERROR_FIELD_NOT_FOUND
     }
 
-    DBItem dbitem;
-    GetFieldValue(nIndex, dbitem, SQL_C_UBIGINT);
+    const DBItem& dbitem = GetRowItem(nIndex, SQL_C_UBIGINT);
     switch (dbitem.m_nVarType)
     {
-    case DBItem::lwvt_bytearray:
-        ui64Value = *dbitem.m_pUInt64;
+    case DBItem::lwvt_uint64:
+        ui64Value = dbitem.m_ui64Val;
         return true;
     default:
         return false;
@@ -680,8 +1249,7 @@ bool Query::GetFieldValue(short nIndex, double & dValue)
         throw DbException(SQL_ERROR, SQL_HANDLE_STMT, m_hstmt); // AFX_SQL_ERROR_FIELD_NOT_FOUND
     }
 
-    DBItem dbitem;
-    GetFieldValue(nIndex, dbitem, SQL_C_DOUBLE);
+    const DBItem& dbitem = GetRowItem(nIndex, SQL_C_DOUBLE);
     switch (dbitem.m_nVarType)
     {
     case DBItem::lwvt_double:
@@ -701,12 +1269,11 @@ bool Query::GetFieldValue(short nIndex, SQLGUID& guid)
         throw DbException(SQL_ERROR, SQL_HANDLE_STMT, m_hstmt); // AFX_SQL_ERROR_FIELD_NOT_FOUND
     }
 
-    DBItem dbitem;
-    GetFieldValue(nIndex, dbitem, SQL_C_GUID);
+    const DBItem& dbitem = GetRowItem(nIndex, SQL_C_GUID);
     switch (dbitem.m_nVarType)
     {
     case DBItem::lwvt_guid:
-        guid = *dbitem.m_pGUID;
+        guid = dbitem.m_guidVal;
         return true;
     default:
         return false;
@@ -722,12 +1289,11 @@ bool linguversa::Query::GetFieldValue(short nIndex, TIMESTAMP_STRUCT& tsValue)
         throw DbException(SQL_ERROR, SQL_HANDLE_STMT, m_hstmt); // AFX_SQL_ERROR_FIELD_NOT_FOUND
     }
 
-    DBItem dbitem;
-    GetFieldValue(nIndex, dbitem, SQL_C_TIMESTAMP);
+    const DBItem& dbitem = GetRowItem(nIndex, SQL_C_TIMESTAMP);
     switch (dbitem.m_nVarType)
     {
     case DBItem::lwvt_date:
-        tsValue = *dbitem.m_pdate;
+        tsValue = dbitem.m_dateVal;
         return true;
     default:
         return false;
@@ -745,16 +1311,53 @@ void Query::GetFieldValue(short nIndex, DBItem& varValue, short nFieldType)
     }
 
     #ifdef USE_ROWDATA
-    if (m_RowData.size() > (unsigned short) nIndex && (m_Init[nIndex] || (m_RowFieldState[nIndex] & 0x01)))	// initialized = already read
-    {
-        // copy cached value into varValue
-        varValue = m_RowData[nIndex];
-        return;
-    }
+    // copy cached value into varValue
+    varValue = GetRowItem(nIndex, nFieldType);
+    #else
+    ReadFieldValue(nIndex, varValue, nFieldType);
     #endif
+}
+
+#ifdef USE_ROWDATA
+void Query::UseArena(bool bUseArena)
+{
+    m_RowData.SetMemoryResource(bUseArena ? &m_Arena : nullptr);
+    if (!bUseArena)
+        m_Arena.Release();
+}
+
+void Query::SetMemoryResource(MemoryResource* pResource)
+{
+    m_RowData.SetMemoryResource(pResource);
+    if (pResource != &m_Arena)
+        m_Arena.Release();
+}
+
+const DBItem& Query::GetRowItem(short nIndex, short nFieldType)
+{
+    assert(m_RowData.size() > (unsigned short) nIndex);
+    DBItem& item = m_RowData[nIndex];
+    if (!(m_Init[nIndex] || (m_RowFieldState[nIndex] & 0x01)))	// not yet read
+    {
+        // The items of m_RowData are reset but not cleared by Fetch(),
+        // so reading into them reuses their buffers from row to row.
+        ReadFieldValue(nIndex, item, nFieldType);
+        m_Init[nIndex] = true;
+    }
+    return item;
+}
+#else
+const DBItem& Query::GetRowItem(short nIndex, short nFieldType)
+{
+    ReadFieldValue(nIndex, m_FieldItem, nFieldType);
+    return m_FieldItem;
+}
+#endif
 
-    // Clear the previous variant
-    varValue.clear();
+void Query::ReadFieldValue(short nIndex, DBItem& varValue, short nFieldType)
+{
+    // Reset the previous variant, but keep its buffer
+    varValue.reset();
 
     FieldInfo fieldinfo;
     GetODBCFieldInfo( nIndex, fieldinfo);
@@ -768,7 +1371,16 @@ void Query::GetFieldValue(short nIndex, DBItem& varValue, short nFieldType)
     SQLLEN len = 0; //fieldinfo.m_nPrecision;
     SQLRETURN nRetCode = SQL_ERROR;
 
-    switch (nFieldType)
+    ColumnBinding* pBinding = ((unsigned short) nIndex < m_ColumnBinding.size()) ? m_ColumnBinding[nIndex] : nullptr;
+    if (pBinding != nullptr)
+    {
+        // The value is already in the bound rowset buffer, columns bound with SQLBindCol()
+        // must not be read again with SQLGetData().
+        len = pBinding->GetValue(m_nRowsetPos, varValue);
+        nFieldType = pBinding->m_nCType;
+        nRetCode = SQL_SUCCESS;
+    }
+    else switch (nFieldType)
     {
     case SQL_C_BIT:
     {
@@ -849,36 +1461,17 @@ void Query::GetFieldValue(short nIndex, DBItem& varValue, short nFieldType)
         if (SQL_SUCCEEDED(nRetCode) && len > 0)
         {
             varValue.m_nVarType = DBItem::lwvt_date;
-            varValue.m_pdate = new TIMESTAMP_STRUCT;
-            *varValue.m_pdate = tsValue;
+            varValue.m_dateVal = tsValue;
         }
     } break;
 
-    // special handling of LWVT_BYTEARRAY which is pointer to ByteArray
+    // special handling of LWVT_BYTEARRAY
     case SQL_C_BINARY:
     {
-        // Call SQLGetData to determine the amount of data that's waiting.
-        BYTE b = 0;    // dummy variable, but necessary!
-        nRetCode = ::SQLGetData(m_hstmt, nIndex + 1, nFieldType, &b, 0, &len);
+        // Get all the data at once (if it fits into the scratch buffer).
+        nRetCode = GetLongData(nIndex, nFieldType, 0, m_Scratch, 0, len);
         if (SQL_SUCCEEDED(nRetCode) && len >= 0)
-        {
-            BYTE* buf = new BYTE[len + 1];
-            // Get all the data at once.
-            nRetCode = ::SQLGetData(m_hstmt, nIndex + 1, nFieldType, buf, len + 1, &len);
-            if (SQL_SUCCEEDED(nRetCode))
-            {
-                // initialize varValue with a pointer to bytearray of proper size
-                varValue.m_nVarType = DBItem::lwvt_bytearray;
-                varValue.m_pByteArray = new bytearray();
-                bytearray& ba = *(varValue.m_pByteArray);
-                ba.resize(len);
-                // copy buf to the btearray:
-                for (int i = 0; i < len; i++)
-                    ba[i] = buf[i];
-            }
-
-            delete[] buf;
-        }
+            varValue.SetByteArray(m_Scratch.data(), len);
     } break;
 
     // special handling of LWVT_UINT64 which is pointer to ODBCINT64
@@ -889,8 +1482,7 @@ void Query::GetFieldValue(short nIndex, DBItem& varValue, short nFieldType)
         if (SQL_SUCCEEDED(nRetCode) && len >= 0)
         {
             varValue.m_nVarType = DBItem::lwvt_uint64;
-            varValue.m_pUInt64 = new unsigned ODBCINT64();
-            *varValue.m_pUInt64 = biValue;
+            varValue.m_ui64Val = biValue;
         }
     } break;
 
@@ -904,87 +1496,36 @@ void Query::GetFieldValue(short nIndex, DBItem& varValue, short nFieldType)
         if (SQL_SUCCEEDED(nRetCode) && len >= 0)
         {
             varValue.m_nVarType = DBItem::lwvt_guid;
-            varValue.m_pGUID = new SQLGUID;
-            *varValue.m_pGUID = gValue;
+            varValue.m_guidVal = gValue;
         }
     } break;
 
     case SQL_C_WCHAR:
     {
-        wchar_t c = 0;    // dummy variable, but necessary!
-        nRetCode = ::SQLGetData(m_hstmt, nIndex + 1, SQL_C_WCHAR, &c, 0, &len);
+        // the driver terminates with a SQLWCHAR, which has 2 bytes also where wchar_t has 4
+        nRetCode = GetLongData(nIndex, SQL_C_WCHAR, sizeof(SQLWCHAR), m_Scratch, 0, len);
         if (SQL_SUCCEEDED(nRetCode) && len >= 0)
         {
-            // create a buffer
-            size_t n = len / sizeof(wchar_t);
-            wchar_t* buf = new wchar_t[n + 1];
-            // Get all the data at once.
-            nRetCode = ::SQLGetData(m_hstmt, nIndex + 1, SQL_C_WCHAR, buf, (n + 1) * sizeof(wchar_t), &len);
-            if (SQL_SUCCEEDED(nRetCode))
-            {
-                buf[n] = (wchar_t)0;
-                // initialize varValue with a pointer to wstring
-                #ifdef UNICODE
-                varValue.m_nVarType = DBItem::lwvt_string;
-                #else
-                varValue.m_nVarType = DBItem::lwvt_wstring;
-                #endif
-                varValue.m_pstringw = new wstring();
-                varValue.m_pstringw->assign(buf);
-            }
-
-            delete[] buf;
+            // lwvt_string in UNICODE builds, otherwise lwvt_wstring
+            varValue.SetStringW((const wchar_t*) m_Scratch.data(), len / sizeof(wchar_t));
         }
     } break;
     
     case SQL_C_CHAR:
     {
-        char c = 0;    // dummy variable, but necessary!
-        nRetCode = ::SQLGetData(m_hstmt, nIndex + 1, SQL_C_CHAR, &c, 0, &len);
+        nRetCode = GetLongData(nIndex, SQL_C_CHAR, sizeof(char), m_Scratch, 0, len);
         if (SQL_SUCCEEDED(nRetCode) && len >= 0)
         {
-            // create a buffer
-            char* buf = new char[len + 1];
-            // Get all the data at once.
-            nRetCode = ::SQLGetData(m_hstmt, nIndex + 1, SQL_C_CHAR, buf, len + 1, &len);
-            if (SQL_SUCCEEDED(nRetCode))
-            {
-                buf[len] = (char) 0;
-                // initialize varValue with a pointer to string
-                #ifdef UNICODE
-                varValue.m_nVarType = DBItem::lwvt_astring;
-                #else
-                varValue.m_nVarType = DBItem::lwvt_string;
-                #endif
-                varValue.m_pstringa = new string();
-                varValue.m_pstringa->assign(buf);
-            }
-
-            delete[] buf;
+            // lwvt_astring in UNICODE builds, otherwise lwvt_string
+            varValue.SetStringA((const char*) m_Scratch.data(), len);
         }
     } break;
 
     default:    // most sql types can be converted to tstring
     {
-        TCHAR c = 0;    // dummy variable, but necessary!
-        nRetCode = ::SQLGetData(m_hstmt, nIndex + 1, SQL_C_TCHAR, &c, 0, &len);
+        nRetCode = GetLongData(nIndex, SQL_C_TCHAR, sizeof(SQLTCHAR), m_Scratch, 0, len);
         if (SQL_SUCCEEDED(nRetCode) && len >= 0)
-        {
-            // create a buffer
-            size_t n = len/sizeof(TCHAR);
-            TCHAR* buf = new TCHAR[n + 1];
-            // Get all the data at once.
-            nRetCode = ::SQLGetData(m_hstmt, nIndex + 1, SQL_C_TCHAR, buf, (n + 1) * sizeof(TCHAR), &len);
-            if (SQL_SUCCEEDED(nRetCode))
-            {
-                // initialize varValue with a pointer to tstring
-                varValue.m_nVarType = DBItem::lwvt_string;
-                varValue.m_pstring = new tstring();
-                varValue.m_pstring->assign(buf);
-            }
-
-            delete[] buf;
-        }
+            varValue.SetString((const TCHAR*) m_Scratch.data(), len / sizeof(TCHAR));
         nFieldType = SQL_C_TCHAR;
     } break;
 
@@ -1018,12 +1559,98 @@ void Query::GetFieldValue(short nIndex, DBItem& varValue, short nFieldType)
         m_RowFieldState[nIndex] |= 0x02;    // null value
 
     m_RowFieldState[nIndex] |= 0x01;    // initialized
+
+    return;
+}
+
+SQLLEN Query::StreamFieldValue(short nIndex, const std::function<void(const unsigned char*, size_t)>& callback,
+    SQLSMALLINT nCType, size_t nChunkSize)
+{
+    if (nIndex < 0 || nIndex >= GetODBCFieldCount())
+        throw DbException(SQL_ERROR, SQL_HANDLE_STMT, m_hstmt);
+
+    const DBItem* pItem = nullptr;
+    DBItem boundValue;
+    ColumnBinding* pBinding = ((unsigned short) nIndex < m_ColumnBinding.size()) ? m_ColumnBinding[nIndex] : nullptr;
+    if (pBinding != nullptr)
+    {
+        pBinding->GetValue(m_nRowsetPos, boundValue);
+        pItem = &boundValue;
+    }
+#ifdef USE_ROWDATA
+    else if (m_Init[nIndex] || (m_RowFieldState[nIndex] & 0x01))
+        pItem = &m_RowData[nIndex];
+#endif
+
+    if (pItem != nullptr)
+    {
+        // the value is already in memory, deliver it as it is
+        if (pItem->m_nVarType == DBItem::lwvt_null)
+            return SQL_NULL_DATA;
+        if (DBItem::IsVarLength(pItem->m_nVarType))
+        {
+            if (pItem->GetDataLength() > 0)
+                callback(pItem->GetData(), pItem->GetDataLength());
+            return (SQLLEN) pItem->GetDataLength();
+        }
+        tstring s = DBItem::ConvertToString(*pItem);
+        if (!s.empty())
+            callback((const unsigned char*) s.data(), s.size() * sizeof(TCHAR));
+        return (SQLLEN) (s.size() * sizeof(TCHAR));
+    }
+
+    size_t nTerm = (nCType == SQL_C_CHAR) ? sizeof(char) : (nCType == SQL_C_WCHAR) ? sizeof(SQLWCHAR) : 0;
+    if (nChunkSize < 256)
+        nChunkSize = 256;
+    // wide characters must not be split between two chunks
+    if (nTerm > 1)
+        nChunkSize -= nChunkSize % nTerm;
+    if (m_Scratch.size() < nChunkSize + nTerm)
+        m_Scratch.resize(nChunkSize + nTerm);
+
+    SQLLEN nTotal = 0;
+    for (;;)
+    {
+        SQLLEN len = 0;
+        SQLRETURN nRetCode = ::SQLGetData(m_hstmt, nIndex + 1, nCType, m_Scratch.data(), nChunkSize + nTerm, &len);
+        if (nRetCode == SQL_NO_DATA)
+            break;  // all data has been returned by the previous call
+        if (!SQL_SUCCEEDED(nRetCode))
+            throw DbException(nRetCode, SQL_HANDLE_STMT, m_hstmt);
+        if (len == SQL_NULL_DATA)
+        {
+            nTotal = SQL_NULL_DATA;
+            break;
+        }
+
+        // data truncated (01004): the buffer is filled except for the terminating zero
+        bool bTruncated = nRetCode == SQL_SUCCESS_WITH_INFO && (len == SQL_NO_TOTAL || (size_t) len > nChunkSize);
+        size_t nBytes = bTruncated ? nChunkSize : (size_t) len;
+        if (nBytes > 0)
+            callback(m_Scratch.data(), nBytes);
+        nTotal += (SQLLEN) nBytes;
+        if (!bTruncated)
+            break;
+    }
+
+    // SQLGetData() cannot read the column again
 #ifdef USE_ROWDATA
-    m_RowData[nIndex] = varValue;
+    m_RowData[nIndex].reset();
     m_Init[nIndex] = true;
 #endif
+    if (nTotal == SQL_NULL_DATA)
+        m_RowFieldState[nIndex] |= 0x02;    // null value
+    m_RowFieldState[nIndex] |= 0x01;    // initialized
 
-    return;
+    return nTotal;
+}
+
+SQLLEN Query::StreamFieldValue(short nIndex, std::ostream& os, SQLSMALLINT nCType, size_t nChunkSize)
+{
+    return StreamFieldValue(nIndex, [&os](const unsigned char* p, size_t n)
+    {
+        os.write((const char*) p, (std::streamsize) n);
+    }, nCType, nChunkSize);
 }
 
 bool Query::GetFieldValue(tstring lpszName, DBItem& varValue, short nFieldType)
@@ -1153,6 +1780,61 @@ bool Query::IsFieldNull(tstring lpszName)
 void Query::SetCTypeFormat(const signed short ctype, const tstring fmt)
 {
     m_CTypeFormat[ctype] = fmt;
+    BuildColumnFormats();
+}
+
+void Query::BuildColumnFormats()
+{
+    m_ColumnFormat.resize(m_FieldInfo.size());
+    for (size_t col = 0; col < m_FieldInfo.size(); col++)
+    {
+        const FieldInfo& fi = m_FieldInfo[col];
+        ColumnFormat& cf = m_ColumnFormat[col];
+        // Before the first read of the column its C type is not known yet.
+        cf.m_nCType = (fi.m_nCType != DEFAULT_FIELD_TYPE) ? fi.m_nCType : GetReadCType((short) col);
+        cf.m_bDefaultCType = (cf.m_nCType == fi.GetDefaultCType());
+        auto it = m_CTypeFormat.find(cf.m_nCType);
+        cf.m_bCTypeFormat = (it != m_CTypeFormat.end() && !it->second.empty());
+        cf.m_Formatter = ColumnFormatter(cf.m_bCTypeFormat ? it->second : tstring());
+        cf.m_DecimalFormatter = ColumnFormatter(cf.m_bDefaultCType ? fi.GetDefaultFormat() : tstring());
+    }
+}
+
+signed short Query::GetReadCType(short nIndex) const
+{
+    ColumnBinding* pBinding = ((unsigned short) nIndex < m_ColumnBinding.size()) ? m_ColumnBinding[nIndex] : nullptr;
+    if (pBinding != nullptr)
+        return pBinding->m_nCType;
+
+    // ReadFieldValue() reads all other C types as character data
+    signed short nCType = FieldInfo::GetDefaultCType(m_FieldInfo[nIndex]);
+    switch (nCType)
+    {
+    case SQL_C_BIT:
+    case SQL_C_UTINYINT:
+    case SQL_C_SHORT:
+    case SQL_C_LONG:
+    case SQL_C_FLOAT:
+    case SQL_C_DOUBLE:
+    case SQL_C_TIMESTAMP:
+    case SQL_C_BINARY:
+    case SQL_C_UBIGINT:
+    case SQL_C_GUID:
+    case SQL_C_WCHAR:
+    case SQL_C_CHAR:
+        return nCType;
+    default:
+        return SQL_C_TCHAR;
+    }
+}
+
+tstring Query::FormatColumnValue(const ColumnFormat& columnformat, const DBItem& varValue)
+{
+    // VarType is not CType!
+    bool bDecimal = (varValue.m_nVarType == DBItem::lwvt_single || varValue.m_nVarType == DBItem::lwvt_double);
+    if (!columnformat.m_bCTypeFormat && bDecimal && columnformat.m_bDefaultCType)
+        return columnformat.m_DecimalFormatter.Format(varValue);
+    return columnformat.m_Formatter.Format(varValue);
 }
 
 tstring Query::FormatFieldValue(short nIndex)
@@ -1162,20 +1844,25 @@ tstring Query::FormatFieldValue(short nIndex)
         throw DbException(SQL_ERROR, SQL_HANDLE_STMT, m_hstmt); /* TODO: AFX_SQL_ERROR_FIELD_NOT_FOUND*/
     }
 
-    DBItem varValue;
-    GetFieldValue(nIndex, varValue);
-    FieldInfo& fi = m_FieldInfo[nIndex];
- 
-    tstring fmt = m_CTypeFormat[fi.m_nCType];
-    if (!fmt.empty())
+    return FormatFieldValue(nIndex, GetRowItem(nIndex));
+}
+
+tstring Query::FormatFieldValue(short nIndex, const DBItem& varValue) const
+{
+    const FieldInfo& fi = m_FieldInfo[nIndex];
+    if ((size_t) nIndex < m_ColumnFormat.size() && m_ColumnFormat[nIndex].m_nCType == fi.m_nCType)
+        return FormatColumnValue(m_ColumnFormat[nIndex], varValue);
+
+    // the column has been read with another C type than the formatters were compiled for
+    auto it = m_CTypeFormat.find(fi.m_nCType);
+    if (it != m_CTypeFormat.end() && !it->second.empty())
     {
-        return DBItem::ConvertToString(varValue, fmt);
+        return DBItem::ConvertToString(varValue, it->second);
     }
     // VarType is not CType!
-    if ((varValue.m_nVarType == DBItem::lwvt_single || varValue.m_nVarType == DBItem::lwvt_double) && (m_FieldInfo[nIndex].m_nCType == fi.GetDefaultCType()))
+    if ((varValue.m_nVarType == DBItem::lwvt_single || varValue.m_nVarType == DBItem::lwvt_double) && (fi.m_nCType == fi.GetDefaultCType()))
     {
-        fmt = fi.GetDefaultFormat();
-        return DBItem::ConvertToString(varValue, fmt);
+        return DBItem::ConvertToString(varValue, fi.GetDefaultFormat());
     }
 
     return DBItem::ConvertToString(varValue);
@@ -1183,13 +1870,35 @@ tstring Query::FormatFieldValue(short nIndex)
 
 tstring Query::FormatCurrentRow(const std::tstring fmt)
 {
+#ifdef USE_ROWDATA
     for (unsigned short col = 0; col < m_FieldInfo.size(); col++)
-    {
-        DBItem item;
-        GetFieldValue(col, item);
-    }
+        GetRowItem(col);
 
     return m_RowData.Format(m_FieldInfo, fmt);
+#else
+    DataRow row;
+    GetCurrentRow(row);
+    return row.Format(m_FieldInfo, fmt);
+#endif
+}
+
+tstring Query::FormatRow(const DataRow& row, const std::tstring fmt) const
+{
+    return row.Format(m_FieldInfo, fmt);
+}
+
+void Query::FormatCurrentRow(const RowFormatter& formatter, tstring& text)
+{
+#ifdef USE_ROWDATA
+    for (unsigned short col = 0; col < m_FieldInfo.size(); col++)
+        GetRowItem(col);
+
+    formatter.Format(m_RowData, text);
+#else
+    DataRow row;
+    GetCurrentRow(row);
+    formatter.Format(row, text);
+#endif
 }
 
 RETCODE Query::Prepare(tstring statement)
@@ -1201,10 +1910,41 @@ RETCODE Query::Prepare(tstring statement)
     if (m_hdbc == NULL)
         return SQL_INVALID_HANDLE;  // TODO
 
+    bool bCache = m_pConnection != nullptr && m_pConnection->GetStatementCacheSize() > 0;
+    if (bCache && m_bCachedStatement)
+    {
+        // return the previous statement
+        ReleaseCachedStatement();
+        InitData();
+    }
+
+    if (bCache && m_hstmt == NULL && m_pConnection->CheckOutStatement(statement, m_Prepared))
+    {
+        // already prepared and described
+        SetStatementHandle(m_Prepared.m_hstmt);
+        m_bCachedStatement = true;
+        ApplyQueryTimeout();
+        m_strStatement = statement;
+        m_nFieldCount = -1;
+        if (m_ParamItem.size() < m_Prepared.m_Params.size())
+            m_ParamItem.resize(m_Prepared.m_Params.size(), (ParamItem*) nullptr);
+        for (size_t i = 1; i < m_Prepared.m_Params.size(); i++)
+        {
+            ParamItem* pPi = m_ParamItem[i] ? m_ParamItem[i] : new ParamItem();
+            (ParamInfo&) *pPi = m_Prepared.m_Params[i];
+            pPi->m_nParamLen = (SQLLEN) pPi->m_nPrecision;
+            m_ParamItem[i] = pPi;
+        }
+        m_ParamInitComplete = true;
+        return SQL_SUCCESS;
+    }
+
+    // a new handle goes to the statement cache when it is no longer used
+    bool bNewHandle = (m_hstmt == NULL);
     if (m_hstmt == NULL)
     {
         // Allocate new Statement Handle based on existing connection
-        nRetCode = ::SQLAllocHandle(SQL_HANDLE_STMT, m_hdbc, &m_hstmt);
+        nRetCode = AllocStatement();
         if (!SQL_SUCCEEDED(nRetCode) || m_hstmt == NULL)
         {
             //throw DbException(nRetCode, m_Database, m_hstmt);
@@ -1220,6 +1960,8 @@ RETCODE Query::Prepare(tstring statement)
         throw DbException(nRetCode, SQL_HANDLE_STMT, m_hstmt);
         return nRetCode;
     }
+    m_strStatement = statement;
+    m_nFieldCount = -1;
 
     SQLSMALLINT nParams;
     do {
@@ -1279,6 +2021,16 @@ RETCODE Query::Prepare(tstring statement)
         m_ParamItem[i] = pPi;
     }
 
+    if (bCache && bNewHandle)
+    {
+        // only a completely prepared and described statement goes into the cache
+        m_bCachedStatement = true;
+        m_Prepared = Connection::PreparedStatement();
+        m_Prepared.m_Params.resize(nParams + 1);
+        for (SQLUSMALLINT i = 1; i <= nParams; i++)
+            m_Prepared.m_Params[i] = *m_ParamItem[i];
+    }
+
     m_ParamInitComplete = true;
 
     return nRetCode;
@@ -1430,7 +2182,7 @@ SQLRETURN Query::SetParamName(SQLUSMALLINT ParameterNumber, tstring ParameterNam
     if (m_hstmt == NULL)
     {
         // Allocate new Statement Handle based on existing connection
-        nRetCode = ::SQLAllocHandle(SQL_HANDLE_STMT, m_hdbc, &m_hstmt);
+        nRetCode = AllocStatement();
         if (! SQL_SUCCEEDED( nRetCode) || m_hstmt == NULL)
         {
             throw DbException(nRetCode, SQL_HANDLE_STMT, m_hstmt);
@@ -1703,11 +2455,12 @@ SQLRETURN Query::Finish()
                 if (buf == nullptr || datarow[i].m_nVarType != DBItem::lwvt_string)
                     return SQL_ERROR;
                 // if the target buffer is not yet large enough
-                if (po->m_nParamLen + 1 < (int)datarow[i].m_pstring->size() && po->m_local)
+                SQLLEN nStrLen = (SQLLEN) (datarow[i].GetDataLength() / sizeof(TCHAR));
+                if (po->m_nParamLen + 1 < nStrLen && po->m_local)
                 {
                     // locally we can simply allocate a larger buffer
                     delete[]((TCHAR*)buf);
-                    po->m_nParamLen = datarow[i].m_pstring->size();
+                    po->m_nParamLen = nStrLen;
                     po->m_pParam = buf = new TCHAR[po->m_nParamLen + 1];
                 }
 
@@ -1716,8 +2469,8 @@ SQLRETURN Query::Finish()
                 // copy tstring from datarow's field into the output parameter's buffer
                 for (int j = 0; j < po->m_nParamLen; j++)
                 {
-                    if (j < (int) datarow[i].m_pstring->size())
-                        buf[j] = (*datarow[i].m_pstring)[j];
+                    if (j < nStrLen)
+                        buf[j] = datarow[i].GetString()[j];
                     else
                         buf[j] = (TCHAR)0x00;
                 }
@@ -1759,7 +2512,7 @@ RETCODE Query::BindParameter(	// 16 bit, SQL_SMALLINT
     if (m_hstmt == NULL)
     {
         // Allocate new Statement Handle based on existing connection
-        nRetCode = ::SQLAllocHandle(SQL_HANDLE_STMT, m_hdbc, &m_hstmt);
+        nRetCode = AllocStatement();
         if (! SQL_SUCCEEDED( nRetCode) || m_hstmt == NULL)
         {
             throw DbException(nRetCode, SQL_HANDLE_STMT, m_hstmt);
@@ -1776,7 +2529,7 @@ RETCODE Query::BindParameter(	// 16 bit, SQL_SMALLINT
         pPi = m_ParamItem[ParameterNumber];
     else
         m_ParamItem.resize(ParameterNumber+1, (ParamItem*) nullptr);
-    if (pPi && pPi->m_local)
+    if (pPi)
         pPi->Clear();	// delete local heap variable before binding a new buffer;
     if (pPi == NULL)
         pPi = new ParamItem();
@@ -1816,7 +2569,7 @@ RETCODE Query::BindParameter(	// 32 bit, SQL_INTEGER
     if (m_hstmt == NULL)
     {
         // Allocate new Statement Handle based on existing connection
-        nRetCode = ::SQLAllocHandle(SQL_HANDLE_STMT, m_hdbc, &m_hstmt);
+        nRetCode = AllocStatement();
         if (! SQL_SUCCEEDED( nRetCode) || m_hstmt == NULL)
         {
             throw DbException(nRetCode, SQL_HANDLE_STMT, m_hstmt);
@@ -1833,7 +2586,7 @@ RETCODE Query::BindParameter(	// 32 bit, SQL_INTEGER
         pPi = m_ParamItem[ParameterNumber];
     else
         m_ParamItem.resize(ParameterNumber+1, (ParamItem*) nullptr);
-    if (pPi && pPi->m_local)
+    if (pPi)
         pPi->Clear();	// delete local heap variable before binding a new buffer;
     if (pPi == NULL)
         pPi = new ParamItem();
@@ -1892,7 +2645,7 @@ RETCODE Query::BindParameter(	// 32 bit, SQL_INTEGER
     if (m_hstmt == NULL)
     {
         // Allocate new Statement Handle based on existing connection
-        nRetCode = ::SQLAllocHandle(SQL_HANDLE_STMT, m_hdbc, &m_hstmt);
+        nRetCode = AllocStatement();
         if (! SQL_SUCCEEDED( nRetCode) || m_hstmt == NULL)
         {
             throw DbException(nRetCode, SQL_HANDLE_STMT, m_hstmt);
@@ -1909,7 +2662,7 @@ RETCODE Query::BindParameter(	// 32 bit, SQL_INTEGER
         pPi = m_ParamItem[ParameterNumber];
     else
         m_ParamItem.resize(ParameterNumber+1, (ParamItem*) nullptr);
-    if (pPi && pPi->m_local)
+    if (pPi)
         pPi->Clear();	// delete local heap variable before binding a new buffer;
     if (pPi == NULL)
         pPi = new ParamItem();
@@ -1968,7 +2721,7 @@ RETCODE Query::BindParameter(	// 64 bit, SQL_BIGINT
     if (m_hstmt == NULL)
     {
         // Allocate new Statement Handle based on existing connection
-        nRetCode = ::SQLAllocHandle(SQL_HANDLE_STMT, m_hdbc, &m_hstmt);
+        nRetCode = AllocStatement();
         if (! SQL_SUCCEEDED( nRetCode) || m_hstmt == NULL)
         {
             throw DbException(nRetCode, SQL_HANDLE_STMT, m_hstmt);
@@ -1985,7 +2738,7 @@ RETCODE Query::BindParameter(	// 64 bit, SQL_BIGINT
         pPi = m_ParamItem[ParameterNumber];
     else
         m_ParamItem.resize(ParameterNumber+1, (ParamItem*) nullptr);
-    if (pPi && pPi->m_local)
+    if (pPi)
         pPi->Clear();	// delete local heap variable before binding a new buffer;
     if (pPi == NULL)
         pPi = new ParamItem();
@@ -2026,7 +2779,7 @@ RETCODE Query::BindParameter(
     if (m_hstmt == NULL)
     {
         // Allocate new Statement Handle based on existing connection
-        nRetCode = ::SQLAllocHandle(SQL_HANDLE_STMT, m_hdbc, &m_hstmt);
+        nRetCode = AllocStatement();
         if (! SQL_SUCCEEDED( nRetCode) || m_hstmt == NULL)
         {
             throw DbException(nRetCode, SQL_HANDLE_STMT, m_hstmt);
@@ -2043,7 +2796,7 @@ RETCODE Query::BindParameter(
         pPi = m_ParamItem[ParameterNumber];
     else
         m_ParamItem.resize(ParameterNumber+1, (ParamItem*) nullptr);
-    if (pPi && pPi->m_local)
+    if (pPi)
         pPi->Clear();	// delete local heap variable before binding a new buffer;
     if (pPi == NULL)
         pPi = new ParamItem();
@@ -2083,7 +2836,7 @@ RETCODE Query::BindParameter(
     if (m_hstmt == NULL)
     {
         // Allocate new Statement Handle based on existing connection
-        nRetCode = ::SQLAllocHandle(SQL_HANDLE_STMT, m_hdbc, &m_hstmt);
+        nRetCode = AllocStatement();
         if (! SQL_SUCCEEDED( nRetCode) || m_hstmt == NULL)
         {
             throw DbException(nRetCode, SQL_HANDLE_STMT, m_hstmt);
@@ -2100,7 +2853,7 @@ RETCODE Query::BindParameter(
         pPi = m_ParamItem[ParameterNumber];
     else
         m_ParamItem.resize(ParameterNumber+1, (ParamItem*) nullptr);
-    if (pPi && pPi->m_local)
+    if (pPi)
         pPi->Clear();	// delete local heap variable before binding a new buffer;
     if (pPi == NULL)
         pPi = new ParamItem();
@@ -2137,7 +2890,145 @@ RETCODE Query::BindParameter(SQLUSMALLINT ParameterNumber, SQLGUID& guid, ParamI
     if (m_hstmt == NULL)
     {
         // Allocate new Statement Handle based on existing connection
-        nRetCode = ::SQLAllocHandle(SQL_HANDLE_STMT, m_hdbc, &m_hstmt);
+        nRetCode = AllocStatement();
+        if (! SQL_SUCCEEDED( nRetCode) || m_hstmt == NULL)
+        {
+            throw DbException(nRetCode, SQL_HANDLE_STMT, m_hstmt);
+            return nRetCode;
+        }
+    }
+
+    assert(m_hstmt);
+    if (m_hdbc == NULL || m_hstmt == NULL)
+        return SQL_INVALID_HANDLE;
+
+    ParamItem* pPi = NULL;
+    if (ParameterNumber < m_ParamItem.size())
+        pPi = m_ParamItem[ParameterNumber];
+    else
+        m_ParamItem.resize(ParameterNumber+1, (ParamItem*) nullptr);
+    if (pPi)
+        pPi->Clear();	// delete local heap variable before binding a new buffer;
+    if (pPi == NULL)
+        pPi = new ParamItem();
+
+    pPi->m_nCType = SQL_C_GUID;
+    pPi->m_pParam = &guid;
+    pPi->m_lenInd = sizeof(SQLGUID);	// will receive the size of the parameter for inouttype SQL_PARAM_OUTPUT or SQL_PARAM_INPUT_OUTPUT
+    pPi->m_local = false;
+    // inouttype must be different from ParamInfo::unknown!
+    if (inouttype != ParamInfo::unknown)
+        pPi->m_InputOutputType = inouttype;
+    else if (pPi->m_InputOutputType != ParamInfo::unknown)
+        inouttype = pPi->m_InputOutputType;
+    else
+        inouttype = pPi->m_InputOutputType = ParamInfo::input;
+    m_ParamItem[ParameterNumber] = pPi;
+
+    nRetCode = ::SQLBindParameter(m_hstmt, ParameterNumber, (SQLSMALLINT) inouttype,
+        (pPi->m_nSQLType == SQL_BINARY) ? SQL_C_BINARY : pPi->m_nCType,
+        pPi->m_nSQLType ? pPi->m_nSQLType : SQL_GUID,
+        (SQLLEN)pPi->m_nParamLen,			// ColumnSize argument
+        (SQLSMALLINT)(pPi->m_nScale >= 0 ? pPi->m_nScale : 0),	// DecimalDigits argument
+        &guid,
+        (SQLINTEGER) sizeof(SQLGUID),		// BufferLength argument
+        &(pPi->m_lenInd));
+
+    return nRetCode;
+}
+
+RETCODE Query::BindParameter(SQLUSMALLINT ParameterNumber, TCHAR* bufParamRef, SQLLEN bufParamlen, ParamInfo::InputOutputType inouttype)
+{
+    RETCODE nRetCode = SQL_SUCCESS;	//Return code for your ODBC calls
+    assert(m_hdbc);
+    if (m_hstmt == NULL)
+    {
+        // Allocate new Statement Handle based on existing connection
+        nRetCode = AllocStatement();
+        if (! SQL_SUCCEEDED( nRetCode) || m_hstmt == NULL)
+        {
+            throw DbException(nRetCode, SQL_HANDLE_STMT, m_hstmt);
+            return nRetCode;
+        }
+    }
+
+    assert(m_hstmt);
+    if (m_hdbc == NULL || m_hstmt == NULL)
+        return SQL_INVALID_HANDLE;
+
+    ParamItem* pPi = NULL;
+    if (ParameterNumber < m_ParamItem.size())
+        pPi = m_ParamItem[ParameterNumber];
+    else
+        m_ParamItem.resize(ParameterNumber+1, (ParamItem*) nullptr);
+    if (pPi)
+        pPi->Clear();	// delete local heap variable before binding a new buffer;
+    if (pPi == NULL)
+        pPi = new ParamItem();
+
+    // if we do not know m_nParamLen from the prepare statement the caller must provide its size with the buffers length
+    if (pPi->m_nParamLen == 0 && bufParamlen > 1)
+        pPi->m_nParamLen = bufParamlen - 1;
+
+    //pPi->m_dwType = LWVT_TCHARBUFFER;
+    pPi->m_nCType = SQL_C_TCHAR;
+    pPi->m_pParam = bufParamRef;
+    pPi->m_lenInd = SQL_NTS;	// null terminted tstring
+    pPi->m_local = false;
+    // inouttype must be different from ParamInfo::unknown!
+    if (inouttype != ParamInfo::unknown)
+        pPi->m_InputOutputType = inouttype;
+    else if (pPi->m_InputOutputType != ParamInfo::unknown)
+        inouttype = pPi->m_InputOutputType;
+    else
+        inouttype = pPi->m_InputOutputType = ParamInfo::input;
+    m_ParamItem[ParameterNumber] = pPi;
+
+    nRetCode = ::SQLBindParameter(m_hstmt, ParameterNumber, (SQLSMALLINT) inouttype,
+#ifdef _UNICODE
+        SQL_C_WCHAR,
+        pPi->m_nSQLType ? pPi->m_nSQLType : SQL_WVARCHAR,
+#else
+        SQL_C_CHAR,
+        pPi->m_nSQLType ? pPi->m_nSQLType : SQL_VARCHAR,
+#endif
+        //SQL_CHAR,	SQL_VARCHAR, SQL_LONGVARCHAR, LONG VARCHAR, SQL_WCHAR, WCHAR, SQL_WVARCHAR, VARWCHAR, SQL_WLONGVARCHAR
+        (SQLLEN)pPi->m_nParamLen,			// ColumnSize argument
+        (SQLSMALLINT)(pPi->m_nScale >= 0 ? pPi->m_nScale : 0),	// DecimalDigits argument
+        bufParamRef,	// no extra for the terminating 0
+        (SQLINTEGER)(bufParamlen) * sizeof(TCHAR),
+        &(pPi->m_lenInd));
+
+    return nRetCode;
+}
+
+RETCODE Query::BindParameter(tstring ParameterName, TCHAR* bufParamRef, SQLLEN bufParamlen, ParamInfo::InputOutputType inouttype)
+{
+    RETCODE nRetCode = SQL_SUCCESS;
+    int n = GetParamIndexByName(ParameterName);
+    if (n < 0)
+        return SQL_ERROR;
+
+    // Populate record #n of ipd.  
+    nRetCode = BindParameter(n, bufParamRef, bufParamlen, inouttype);
+    if (!SQL_SUCCEEDED(nRetCode) || m_hstmt == NULL)
+    {
+        throw DbException(nRetCode, SQL_HANDLE_STMT, m_hstmt);
+        return nRetCode;
+    }
+
+    nRetCode = SetParamName(n, ParameterName);
+    return nRetCode;
+}
+
+RETCODE Query::BindParameter(SQLUSMALLINT ParameterNumber, BYTE* pBa, SQLLEN paramDataLen, SQLLEN paramBufLen, ParamInfo::InputOutputType inouttype)
+{
+    RETCODE nRetCode = SQL_SUCCESS;	//Return code for your ODBC calls
+    assert(m_hdbc);
+    if (m_hstmt == NULL)
+    {
+        // Allocate new Statement Handle based on existing connection
+        nRetCode = AllocStatement();
         if (! SQL_SUCCEEDED( nRetCode) || m_hstmt == NULL)
         {
             throw DbException(nRetCode, SQL_HANDLE_STMT, m_hstmt);
@@ -2154,12 +3045,25 @@ RETCODE Query::BindParameter(SQLUSMALLINT ParameterNumber, SQLGUID& guid, ParamI
         pPi = m_ParamItem[ParameterNumber];
     else
         m_ParamItem.resize(ParameterNumber+1, (ParamItem*) nullptr);
+    if (pPi)
+        pPi->Clear();	// delete local heap variable before binding a new buffer;
     if (pPi == NULL)
         pPi = new ParamItem();
 
-    pPi->m_nCType = SQL_C_GUID;
-    pPi->m_pParam = &guid;
-    pPi->m_lenInd = sizeof(SQLGUID);	// will receive the size of the parameter for inouttype SQL_PARAM_OUTPUT or SQL_PARAM_INPUT_OUTPUT
+    //pPi->m_dwType = LWVT_TCHARBUFFER;
+    pPi->m_nCType = SQL_C_BINARY;
+    pPi->m_pParam = pBa;
+    pPi->m_lenInd = paramDataLen;	// length of valid data in bytes or special marker for NULL data
+    if (pPi->m_lenInd < 0 && pPi->m_lenInd != SQL_NULL_DATA)
+        pPi->m_lenInd = 0;
+
+    if (paramBufLen == 0 && pPi->m_lenInd > 0)
+        paramBufLen = pPi->m_lenInd;
+
+    // if we do not know m_nParamLen from the prepare statement the caller must provide its size with the buffers length
+    if (pPi->m_nParamLen <= 0 && paramBufLen > 0)
+        pPi->m_nParamLen = paramBufLen;
+
     pPi->m_local = false;
     // inouttype must be different from ParamInfo::unknown!
     if (inouttype != ParamInfo::unknown)
@@ -2171,25 +3075,26 @@ RETCODE Query::BindParameter(SQLUSMALLINT ParameterNumber, SQLGUID& guid, ParamI
     m_ParamItem[ParameterNumber] = pPi;
 
     nRetCode = ::SQLBindParameter(m_hstmt, ParameterNumber, (SQLSMALLINT) inouttype,
-        (pPi->m_nSQLType == SQL_BINARY) ? SQL_C_BINARY : pPi->m_nCType,
-        pPi->m_nSQLType ? pPi->m_nSQLType : SQL_GUID,
-        (SQLLEN)pPi->m_nParamLen,			// ColumnSize argument
+        pPi->m_nCType,
+        pPi->m_nSQLType ? pPi->m_nSQLType : SQL_BINARY,
+        (SQLULEN)pPi->m_nParamLen,			// ColumnSize argument
         (SQLSMALLINT)(pPi->m_nScale >= 0 ? pPi->m_nScale : 0),	// DecimalDigits argument
-        &guid,
-        (SQLINTEGER) sizeof(SQLGUID),		// BufferLength argument
-        &(pPi->m_lenInd));
+        pBa,	// no extra since there is no terminating 0
+        (SQLLEN)(paramBufLen),	// allocated buffer size (must stay valid for complete life cycle of the statement)
+        &(pPi->m_lenInd));	// real data length (can change on execution but must never be larger than paramBufLen)
 
     return nRetCode;
 }
 
-RETCODE Query::BindParameter(SQLUSMALLINT ParameterNumber, TCHAR* bufParamRef, SQLLEN bufParamlen, ParamInfo::InputOutputType inouttype)
+RETCODE Query::BindParameter(SQLUSMALLINT ParameterNumber, const std::function<size_t(unsigned char*, size_t)>& producer,
+    SQLLEN nLength, SQLSMALLINT nCType)
 {
     RETCODE nRetCode = SQL_SUCCESS;	//Return code for your ODBC calls
     assert(m_hdbc);
     if (m_hstmt == NULL)
     {
         // Allocate new Statement Handle based on existing connection
-        nRetCode = ::SQLAllocHandle(SQL_HANDLE_STMT, m_hdbc, &m_hstmt);
+        nRetCode = AllocStatement();
         if (! SQL_SUCCEEDED( nRetCode) || m_hstmt == NULL)
         {
             throw DbException(nRetCode, SQL_HANDLE_STMT, m_hstmt);
@@ -2208,70 +3113,163 @@ RETCODE Query::BindParameter(SQLUSMALLINT ParameterNumber, TCHAR* bufParamRef, S
         m_ParamItem.resize(ParameterNumber+1, (ParamItem*) nullptr);
     if (pPi == NULL)
         pPi = new ParamItem();
+    else
+        pPi->Clear();
 
-    // if we do not know m_nParamLen from the prepare statement the caller must provide its size with the buffers length
-    if (pPi->m_nParamLen == 0 && bufParamlen > 1)
-        pPi->m_nParamLen = bufParamlen - 1;
-
-    //pPi->m_dwType = LWVT_TCHARBUFFER;
-    pPi->m_nCType = SQL_C_TCHAR;
-    pPi->m_pParam = bufParamRef;
-    pPi->m_lenInd = SQL_NTS;	// null terminted tstring
+    pPi->m_nCType = nCType;
+    // there is no buffer, the driver asks for the value with SQLParamData()
+    pPi->m_pParam = NULL;
+    pPi->m_Producer = producer;
+    pPi->m_lenInd = (nLength >= 0) ? SQL_LEN_DATA_AT_EXEC(nLength) : SQL_DATA_AT_EXEC;
     pPi->m_local = false;
-    // inouttype must be different from ParamInfo::unknown!
-    if (inouttype != ParamInfo::unknown)
-        pPi->m_InputOutputType = inouttype;
-    else if (pPi->m_InputOutputType != ParamInfo::unknown)
-        inouttype = pPi->m_InputOutputType;
-    else
-        inouttype = pPi->m_InputOutputType = ParamInfo::input;
+    pPi->m_InputOutputType = ParamInfo::input;
     m_ParamItem[ParameterNumber] = pPi;
 
-    nRetCode = ::SQLBindParameter(m_hstmt, ParameterNumber, (SQLSMALLINT) inouttype,
-#ifdef _UNICODE
-        SQL_C_WCHAR,
-        pPi->m_nSQLType ? pPi->m_nSQLType : SQL_WVARCHAR,
-#else
-        SQL_C_CHAR,
-        pPi->m_nSQLType ? pPi->m_nSQLType : SQL_VARCHAR,
-#endif
-        //SQL_CHAR,	SQL_VARCHAR, SQL_LONGVARCHAR, LONG VARCHAR, SQL_WCHAR, WCHAR, SQL_WVARCHAR, VARWCHAR, SQL_WLONGVARCHAR
-        (SQLLEN)pPi->m_nParamLen,			// ColumnSize argument
+    SQLSMALLINT nSqlType = pPi->m_nSQLType;
+    if (nSqlType == 0)
+        nSqlType = (nCType == SQL_C_BINARY) ? SQL_LONGVARBINARY : (nCType == SQL_C_WCHAR) ? SQL_WLONGVARCHAR : SQL_LONGVARCHAR;
+    SQLULEN nColumnSize = (pPi->m_nParamLen > 0) ? (SQLULEN) pPi->m_nParamLen : (nLength > 0) ? (SQLULEN) nLength : 0x7fffffff;
+    if (nCType == SQL_C_WCHAR && pPi->m_nParamLen <= 0 && nLength > 0)
+        nColumnSize = (SQLULEN) nLength / sizeof(SQLWCHAR);
+
+    // The ParameterValuePtr is handed back by SQLParamData() to identify the parameter.
+    nRetCode = ::SQLBindParameter(m_hstmt, ParameterNumber, SQL_PARAM_INPUT,
+        nCType,
+        nSqlType,
+        nColumnSize,			// ColumnSize argument
         (SQLSMALLINT)(pPi->m_nScale >= 0 ? pPi->m_nScale : 0),	// DecimalDigits argument
-        bufParamRef,	// no extra for the terminating 0
-        (SQLINTEGER)(bufParamlen) * sizeof(TCHAR),
-        &(pPi->m_lenInd));
+        (SQLPOINTER) pPi,
+        0,
+        &(pPi->m_lenInd));	// SQL_DATA_AT_EXEC or SQL_LEN_DATA_AT_EXEC(length)
 
     return nRetCode;
 }
 
-RETCODE Query::BindParameter(tstring ParameterName, TCHAR* bufParamRef, SQLLEN bufParamlen, ParamInfo::InputOutputType inouttype)
+RETCODE Query::BindParameter(SQLUSMALLINT ParameterNumber, std::istream& is, SQLLEN nLength, SQLSMALLINT nCType)
 {
-    RETCODE nRetCode = SQL_SUCCESS;
-    int n = GetParamIndexByName(ParameterName);
-    if (n < 0)
-        return SQL_ERROR;
+    return BindParameter(ParameterNumber, [&is](unsigned char* pBuf, size_t nBufLen)
+    {
+        is.read((char*) pBuf, (std::streamsize) nBufLen);
+        return (size_t) is.gcount();
+    }, nLength, nCType);
+}
 
-    // Populate record #n of ipd.  
-    nRetCode = BindParameter(n, bufParamRef, bufParamlen, inouttype);
-    if (!SQL_SUCCEEDED(nRetCode) || m_hstmt == NULL)
+SQLRETURN Query::PutParamData(SQLRETURN nRetCode)
+{
+    if (nRetCode != SQL_NEED_DATA)
+        return nRetCode;
+
+    size_t nChunkSize = m_nPutDataChunkSize - m_nPutDataChunkSize % sizeof(SQLWCHAR);
+    if (m_Scratch.size() < nChunkSize)
+        m_Scratch.resize(nChunkSize);
+
+    for (;;)
+    {
+        // SQLParamData() returns the ParameterValuePtr of the next parameter it needs,
+        // and the return code of the statement after the last one.
+        SQLPOINTER pToken = NULL;
+        nRetCode = ::SQLParamData(m_hstmt, &pToken);
+        if (nRetCode != SQL_NEED_DATA)
+            return nRetCode;
+
+        ParamItem* pPi = nullptr;
+        for (size_t i = 0; i < m_ParamItem.size() && pPi == nullptr; i++)
+        {
+            if (m_ParamItem[i] != nullptr && m_ParamItem[i] == (ParamItem*) pToken && m_ParamItem[i]->m_Producer)
+                pPi = m_ParamItem[i];
+        }
+        if (pPi == nullptr)
+        {
+            ::SQLCancel(m_hstmt);
+            throw DbException(SQL_ERROR, SQL_HANDLE_STMT, m_hstmt);
+        }
+
+        bool bEmpty = true;
+        for (;;)
+        {
+            size_t nBytes = 0;
+            try
+            {
+                nBytes = pPi->m_Producer(m_Scratch.data(), nChunkSize);
+            }
+            catch (...)
+            {
+                // leave the need data state, otherwise the statement cannot be used any more
+                ::SQLCancel(m_hstmt);
+                throw;
+            }
+            if (nBytes == 0 && !bEmpty)
+                break;
+
+            SQLRETURN nRetCode2 = ::SQLPutData(m_hstmt, m_Scratch.data(), (SQLLEN) nBytes);
+            if (!SQL_SUCCEEDED(nRetCode2))
+            {
+                DbException ex(nRetCode2, SQL_HANDLE_STMT, m_hstmt);
+                ::SQLCancel(m_hstmt);
+                throw ex;
+            }
+            bEmpty = false;
+            if (nBytes == 0)
+                break;  // an empty value has been sent
+        }
+    }
+}
+
+SQLRETURN Query::SetParamsetSize(SQLULEN nParamsetSize)
+{
+    RETCODE nRetCode = SQL_SUCCESS;	//Return code for your ODBC calls
+    assert(m_hdbc);
+    if (m_hstmt == NULL)
+    {
+        // Allocate new Statement Handle based on existing connection
+        nRetCode = AllocStatement();
+        if (! SQL_SUCCEEDED( nRetCode) || m_hstmt == NULL)
+        {
+            throw DbException(nRetCode, SQL_HANDLE_STMT, m_hstmt);
+            return nRetCode;
+        }
+    }
+
+    if (nParamsetSize < 1)
+        nParamsetSize = 1;
+
+    // the status array must exist before the driver gets its address
+    m_ParamStatus.assign(nParamsetSize > 1 ? nParamsetSize : 0, SQL_PARAM_UNUSED);
+    m_nParamsProcessed = 0;
+
+    nRetCode = ::SQLSetStmtAttr(m_hstmt, SQL_ATTR_PARAM_BIND_TYPE, (SQLPOINTER) SQL_PARAM_BIND_BY_COLUMN, 0);
+    if (SQL_SUCCEEDED(nRetCode))
+        nRetCode = ::SQLSetStmtAttr(m_hstmt, SQL_ATTR_PARAMSET_SIZE, (SQLPOINTER) nParamsetSize, 0);
+    if (SQL_SUCCEEDED(nRetCode))
+        nRetCode = ::SQLSetStmtAttr(m_hstmt, SQL_ATTR_PARAM_STATUS_PTR, m_ParamStatus.empty() ? nullptr : m_ParamStatus.data(), 0);
+    if (SQL_SUCCEEDED(nRetCode))
+        nRetCode = ::SQLSetStmtAttr(m_hstmt, SQL_ATTR_PARAMS_PROCESSED_PTR, nParamsetSize > 1 ? &m_nParamsProcessed : nullptr, 0);
+    if (!SQL_SUCCEEDED(nRetCode))
     {
         throw DbException(nRetCode, SQL_HANDLE_STMT, m_hstmt);
         return nRetCode;
     }
 
-    nRetCode = SetParamName(n, ParameterName);
+    m_nParamsetSize = nParamsetSize;
     return nRetCode;
 }
 
-RETCODE Query::BindParameter(SQLUSMALLINT ParameterNumber, BYTE* pBa, SQLLEN paramDataLen, SQLLEN paramBufLen, ParamInfo::InputOutputType inouttype)
+SQLUSMALLINT Query::GetParamStatus(SQLULEN nRow) const
+{
+    if (m_ParamStatus.empty())
+        return (nRow == 0) ? SQL_PARAM_SUCCESS : SQL_PARAM_UNUSED;
+    return (nRow < m_ParamStatus.size()) ? m_ParamStatus[nRow] : SQL_PARAM_UNUSED;
+}
+
+RETCODE Query::BindParamArray(SQLUSMALLINT ParameterNumber, SQLSMALLINT nCType, SQLSMALLINT nDefaultSqlType,
+    void* pArray, SQLLEN nElementSize, SQLLEN* pLenInd, ParamInfo::InputOutputType inouttype)
 {
     RETCODE nRetCode = SQL_SUCCESS;	//Return code for your ODBC calls
     assert(m_hdbc);
     if (m_hstmt == NULL)
     {
         // Allocate new Statement Handle based on existing connection
-        nRetCode = ::SQLAllocHandle(SQL_HANDLE_STMT, m_hdbc, &m_hstmt);
+        nRetCode = AllocStatement();
         if (! SQL_SUCCEEDED( nRetCode) || m_hstmt == NULL)
         {
             throw DbException(nRetCode, SQL_HANDLE_STMT, m_hstmt);
@@ -2288,23 +3286,24 @@ RETCODE Query::BindParameter(SQLUSMALLINT ParameterNumber, BYTE* pBa, SQLLEN par
         pPi = m_ParamItem[ParameterNumber];
     else
         m_ParamItem.resize(ParameterNumber+1, (ParamItem*) nullptr);
+    if (pPi)
+        pPi->Clear();	// delete local heap variable before binding a new buffer;
     if (pPi == NULL)
         pPi = new ParamItem();
 
-    //pPi->m_dwType = LWVT_TCHARBUFFER;
-    pPi->m_nCType = SQL_C_BINARY;
-    pPi->m_pParam = pBa;
-    pPi->m_lenInd = paramDataLen;	// length of valid data in bytes or special marker for NULL data
-    if (pPi->m_lenInd < 0 && pPi->m_lenInd != SQL_NULL_DATA)
-        pPi->m_lenInd = 0;
-
-    if (paramBufLen == 0 && pPi->m_lenInd > 0)
-        paramBufLen = pPi->m_lenInd;
-
-    // if we do not know m_nParamLen from the prepare statement the caller must provide its size with the buffers length
-    if (pPi->m_nParamLen <= 0 && paramBufLen > 0)
-        pPi->m_nParamLen = paramBufLen;
+    // For character and binary data the column size must cover the longest element,
+    // even if Prepare() has found a smaller one.
+    SQLULEN nColumnSize = (SQLULEN) pPi->m_nParamLen;
+    if (nCType == SQL_C_CHAR || nCType == SQL_C_WCHAR || nCType == SQL_C_BINARY)
+    {
+        SQLULEN nElementLen = (nCType == SQL_C_BINARY) ? nElementSize : nElementSize / sizeof(TCHAR) - 1;
+        if (nColumnSize < nElementLen)
+            nColumnSize = nElementLen;
+    }
 
+    pPi->m_nCType = nCType;
+    pPi->m_pParam = pArray;
+    pPi->m_lenInd = 0;	// not used, the lengths are in pLenInd
     pPi->m_local = false;
     // inouttype must be different from ParamInfo::unknown!
     if (inouttype != ParamInfo::unknown)
@@ -2315,14 +3314,182 @@ RETCODE Query::BindParameter(SQLUSMALLINT ParameterNumber, BYTE* pBa, SQLLEN par
         inouttype = pPi->m_InputOutputType = ParamInfo::input;
     m_ParamItem[ParameterNumber] = pPi;
 
+    // Bound column-wise, the driver steps through pArray by BufferLength for character and binary data
+    // and by the size of the C type otherwise.
     nRetCode = ::SQLBindParameter(m_hstmt, ParameterNumber, (SQLSMALLINT) inouttype,
-        pPi->m_nCType,
-        pPi->m_nSQLType ? pPi->m_nSQLType : SQL_BINARY,
-        (SQLULEN)pPi->m_nParamLen,			// ColumnSize argument
+        nCType,
+        pPi->m_nSQLType ? pPi->m_nSQLType : nDefaultSqlType,
+        nColumnSize,			// ColumnSize argument
         (SQLSMALLINT)(pPi->m_nScale >= 0 ? pPi->m_nScale : 0),	// DecimalDigits argument
-        pBa,	// no extra since there is no terminating 0
-        (SQLLEN)(paramBufLen),	// allocated buffer size (must stay valid for complete life cycle of the statement)
-        &(pPi->m_lenInd));	// real data length (can change on execution but must never be larger than paramBufLen)
+        pArray,
+        nElementSize,		// BufferLength argument
+        pLenInd);
+
+    if (!SQL_SUCCEEDED(nRetCode))
+    {
+        throw DbException(nRetCode, SQL_HANDLE_STMT, m_hstmt);
+        return nRetCode;
+    }
+
+    return nRetCode;
+}
+
+RETCODE Query::BindParameterArray(SQLUSMALLINT ParameterNumber, short* pArray, SQLLEN* pLenInd, ParamInfo::InputOutputType inouttype)
+{
+    return BindParamArray(ParameterNumber, SQL_C_SHORT, SQL_SMALLINT, pArray, sizeof(short), pLenInd, inouttype);
+}
+
+RETCODE Query::BindParameterArray(SQLUSMALLINT ParameterNumber, int* pArray, SQLLEN* pLenInd, ParamInfo::InputOutputType inouttype)
+{
+    static_assert(sizeof(int) == sizeof(SQLINTEGER), "SQL_C_LONG is a 32 bit integer");
+    return BindParamArray(ParameterNumber, SQL_C_LONG, SQL_INTEGER, pArray, sizeof(int), pLenInd, inouttype);
+}
+
+RETCODE Query::BindParameterArray(SQLUSMALLINT ParameterNumber, long* pArray, SQLLEN* pLenInd, ParamInfo::InputOutputType inouttype)
+{
+    // The elements of an array must have exactly the size of the C type, and on 64 bit Linux long has 64 bits.
+    if (sizeof(long) == sizeof(SQLINTEGER))
+        return BindParamArray(ParameterNumber, SQL_C_LONG, SQL_INTEGER, pArray, sizeof(long), pLenInd, inouttype);
+    else
+        return BindParamArray(ParameterNumber, SQL_C_SBIGINT, SQL_INTEGER, pArray, sizeof(long), pLenInd, inouttype);
+}
+
+RETCODE Query::BindParameterArray(SQLUSMALLINT ParameterNumber, unsigned ODBCINT64* pArray, SQLLEN* pLenInd, ParamInfo::InputOutputType inouttype)
+{
+    // same as BindParameter(SQLUSMALLINT, unsigned ODBCINT64&, ...)
+    return BindParamArray(ParameterNumber, SQL_C_SBIGINT, SQL_BIGINT, pArray, sizeof(unsigned ODBCINT64), pLenInd, inouttype);
+}
+
+RETCODE Query::BindParameterArray(SQLUSMALLINT ParameterNumber, double* pArray, SQLLEN* pLenInd, ParamInfo::InputOutputType inouttype)
+{
+    return BindParamArray(ParameterNumber, SQL_C_DOUBLE, SQL_DOUBLE, pArray, sizeof(double), pLenInd, inouttype);
+}
+
+RETCODE Query::BindParameterArray(SQLUSMALLINT ParameterNumber, TIMESTAMP_STRUCT* pArray, SQLLEN* pLenInd, ParamInfo::InputOutputType inouttype)
+{
+    return BindParamArray(ParameterNumber, SQL_C_TIMESTAMP, SQL_TIMESTAMP, pArray, sizeof(TIMESTAMP_STRUCT), pLenInd, inouttype);
+}
+
+RETCODE Query::BindParameterArray(SQLUSMALLINT ParameterNumber, SQLGUID* pArray, SQLLEN* pLenInd, ParamInfo::InputOutputType inouttype)
+{
+    return BindParamArray(ParameterNumber, SQL_C_GUID, SQL_GUID, pArray, sizeof(SQLGUID), pLenInd, inouttype);
+}
+
+RETCODE Query::BindParameterArray(SQLUSMALLINT ParameterNumber, TCHAR* pBuf, SQLLEN nElementLen, SQLLEN* pLenInd, ParamInfo::InputOutputType inouttype)
+{
+    if (nElementLen <= 1)
+        return SQL_ERROR;
+
+#ifdef _UNICODE
+    return BindParamArray(ParameterNumber, SQL_C_WCHAR, SQL_WVARCHAR, pBuf, nElementLen * sizeof(TCHAR), pLenInd, inouttype);
+#else
+    return BindParamArray(ParameterNumber, SQL_C_CHAR, SQL_VARCHAR, pBuf, nElementLen * sizeof(TCHAR), pLenInd, inouttype);
+#endif
+}
+
+RETCODE Query::BindParameterArray(SQLUSMALLINT ParameterNumber, BYTE* pBuf, SQLLEN nElementLen, SQLLEN* pLenInd, ParamInfo::InputOutputType inouttype)
+{
+    // binary data has no terminating 0, so the driver needs the length of each element
+    assert(pLenInd != nullptr);
+    if (nElementLen <= 0 || pLenInd == nullptr)
+        return SQL_ERROR;
+
+    return BindParamArray(ParameterNumber, SQL_C_BINARY, SQL_BINARY, pBuf, nElementLen, pLenInd, inouttype);
+}
+
+RETCODE Query::ExecuteBatch(const ColumnBatch& batch)
+{
+    size_t nRows = batch.GetRowCount();
+    if (nRows == 0)
+        return SQL_SUCCESS;
+
+    SetParamsetSize(nRows);
+
+    size_t nCols = batch.GetColumnCount();
+    m_BatchData.resize(nCols);
+    m_BatchLenInd.resize(nCols);
+    for (size_t col = 0; col < nCols; col++)
+    {
+        const ColumnVector& cv = batch[col];
+        vector<SQLLEN>& lenInd = m_BatchLenInd[col];
+        lenInd.resize(nRows);
+        for (size_t row = 0; row < nRows; row++)
+            lenInd[row] = cv.IsNull(row) ? SQL_NULL_DATA : 0;
+
+        // The driver only reads input parameters, the const_casts are for SQLBindParameter() only.
+        SQLUSMALLINT nParam = (SQLUSMALLINT) (col + 1);
+        switch (cv.GetType())
+        {
+        case ColumnVector::cv_int32:
+            BindParamArray(nParam, SQL_C_SLONG, SQL_INTEGER, const_cast<SQLINTEGER*>(cv.m_Int32.data()),
+                sizeof(SQLINTEGER), lenInd.data(), ParamInfo::input);
+            break;
+        case ColumnVector::cv_int64:
+            BindParamArray(nParam, SQL_C_SBIGINT, SQL_BIGINT, const_cast<SQLBIGINT*>(cv.m_Int64.data()),
+                sizeof(SQLBIGINT), lenInd.data(), ParamInfo::input);
+            break;
+        case ColumnVector::cv_double:
+            BindParamArray(nParam, SQL_C_DOUBLE, SQL_DOUBLE, const_cast<double*>(cv.m_Double.data()),
+                sizeof(double), lenInd.data(), ParamInfo::input);
+            break;
+        case ColumnVector::cv_timestamp:
+            BindParamArray(nParam, SQL_C_TIMESTAMP, SQL_TIMESTAMP, const_cast<TIMESTAMP_STRUCT*>(cv.m_Timestamp.data()),
+                sizeof(TIMESTAMP_STRUCT), lenInd.data(), ParamInfo::input);
+            break;
+        case ColumnVector::cv_string:
+        case ColumnVector::cv_binary:
+        {
+            // ODBC needs elements of equal size: copy the values from m_Data into slots of the longest one
+            bool bString = (cv.GetType() == ColumnVector::cv_string);
+            // guids are stored as SQLGUID in binary columns
+            bool bGuid = !bString && col < batch.GetResultInfo().size()
+                && FieldInfo::GetDefaultCType(batch.GetResultInfo()[col]) == SQL_C_GUID;
+            size_t nTerm = bString ? sizeof(TCHAR) : 0;
+            size_t nMaxLen = bString ? sizeof(TCHAR) : bGuid ? sizeof(SQLGUID) : 1;
+            for (size_t row = 0; row < nRows; row++)
+            {
+                size_t nLen = cv.m_Offsets[row + 1] - cv.m_Offsets[row];
+                if (nLen > nMaxLen)
+                    nMaxLen = nLen;
+            }
+
+            size_t nElementSize = nMaxLen + nTerm;
+            bytearray& data = m_BatchData[col];
+            data.assign(nElementSize * nRows, 0);
+            for (size_t row = 0; row < nRows; row++)
+            {
+                size_t nLen = cv.m_Offsets[row + 1] - cv.m_Offsets[row];
+                if (bGuid && nLen > sizeof(SQLGUID))
+                    nLen = sizeof(SQLGUID);
+                if (nLen > 0)
+                    memcpy(data.data() + row * nElementSize, cv.m_Data.data() + cv.m_Offsets[row], nLen);
+                if (lenInd[row] != SQL_NULL_DATA)
+                    lenInd[row] = bGuid ? (SQLLEN) sizeof(SQLGUID) : (SQLLEN) nLen;
+            }
+
+            if (!bString && bGuid)
+                BindParamArray(nParam, SQL_C_GUID, SQL_GUID, data.data(), nElementSize, lenInd.data(), ParamInfo::input);
+            else if (bString)
+#ifdef _UNICODE
+                BindParamArray(nParam, SQL_C_TCHAR, SQL_WVARCHAR, data.data(), nElementSize, lenInd.data(), ParamInfo::input);
+#else
+                BindParamArray(nParam, SQL_C_TCHAR, SQL_VARCHAR, data.data(), nElementSize, lenInd.data(), ParamInfo::input);
+#endif
+            else
+                BindParamArray(nParam, SQL_C_BINARY, SQL_VARBINARY, data.data(), nElementSize, lenInd.data(), ParamInfo::input);
+        } break;
+        }
+    }
+
+    SQLRETURN nRetCode = Execute();
+
+    // Depending on the driver a failed row only yields SQL_SUCCESS_WITH_INFO for the whole array.
+    SQLULEN nProcessed = m_ParamStatus.empty() ? 0 : m_nParamsProcessed;
+    for (SQLULEN row = 0; row < nProcessed && row < m_ParamStatus.size(); row++)
+    {
+        if (m_ParamStatus[row] == SQL_PARAM_ERROR)
+            throw DbException(SQL_ERROR, SQL_HANDLE_STMT, m_hstmt);
+    }
 
     return nRetCode;
 }
@@ -2365,7 +3532,7 @@ RETCODE Query::SetParamValue(SQLUSMALLINT ParameterNumber, long nParamValue, Par
         return SQL_SUCCESS;
     }
 
-    if (pPi && pPi->m_local)
+    if (pPi)
         pPi->Clear();	// delete local heap variable;
 
     long* pLong = new long(nParamValue);	// create new local heap variable
@@ -2399,7 +3566,7 @@ RETCODE Query::SetParamValue(SQLUSMALLINT ParameterNumber, double dParamValue, P
         return SQL_SUCCESS;
     }
 
-    if (pPi && pPi->m_local)
+    if (pPi)
         pPi->Clear();	// delete local heap variable;
 
     double* pDouble = new double(dParamValue);	// create new local heap variable
@@ -2432,7 +3599,7 @@ RETCODE Query::SetParamValue(SQLUSMALLINT ParameterNumber, TIMESTAMP_STRUCT tsPa
 		return SQL_SUCCESS;
     }
 
-    if (pPi && pPi->m_local)
+    if (pPi)
         pPi->Clear();	// delete local heap variable;
 
     TIMESTAMP_STRUCT* pTS = new TIMESTAMP_STRUCT(tsParamValue);	// create new local heap variable
@@ -2465,7 +3632,7 @@ RETCODE Query::SetParamValue(SQLUSMALLINT ParameterNumber, SQLGUID guid, ParamIn
 		return SQL_SUCCESS;
     }
 
-    if (pPi && pPi->m_local)
+    if (pPi)
         pPi->Clear();	// delete local heap variable;
 
     SQLGUID* pGuid = new SQLGUID(guid);	// create new local heap variable
@@ -2511,7 +3678,7 @@ RETCODE Query::SetParamValue(SQLUSMALLINT ParameterNumber, tstring lpszValue, Pa
         }
     }
 
-    if (pPi && pPi->m_local)
+    if (pPi)
         pPi->Clear();	// delete local heap variable;
 
     // create new local buffer on the heap
@@ -2564,7 +3731,7 @@ RETCODE Query::SetParamValue(SQLUSMALLINT ParameterNumber, const bytearray& ba,
     if (fieldlen <= 0)
         fieldlen = ba.size();
 
-    if (pPi && pPi->m_local)
+    if (pPi)
         pPi->Clear();	// delete local heap variable;
 
     // create new local buffer on the heap
@@ -2777,6 +3944,7 @@ void Query::SetParamLenIndicator(SQLUSMALLINT ParameterNumber, SQLLEN lenInd)
 RETCODE Query::Execute()
 {
     RETCODE nRetCode = SQL_SUCCESS;	//Return code for your ODBC calls
+    m_bCancelled = false;
     assert(m_hdbc);
     assert(m_hstmt);
     if (m_hdbc == NULL || m_hstmt == NULL)
@@ -2792,6 +3960,7 @@ RETCODE Query::Execute()
         return nRetCode;
 
     nRetCode = ::SQLExecute(m_hstmt);
+    nRetCode = PutParamData(nRetCode);
 
     // Using ODBC 3 SQLExecDirect/SQLExecute can return SQL_NO_DATA with means SQL_SUCCESS with no rows.
     // From manual:
@@ -2804,7 +3973,7 @@ RETCODE Query::Execute()
         return nRetCode;
     }
 
-    RETCODE nRetCode2 = InitFieldInfos();
+    RETCODE nRetCode2 = InitFieldInfos(m_strStatement.empty() ? nullptr : &m_strStatement);
     if (nRetCode2 != SQL_SUCCESS)
         return nRetCode2;
 
@@ -2816,7 +3985,9 @@ RETCODE Query::Execute()
 
 void Query::InitData()
 {
-    m_hstmt = NULL;
+    SetStatementHandle(SQL_NULL_HSTMT);
+    m_bCachedStatement = false;
+    m_Prepared = Connection::PreparedStatement();
 
     for (unsigned int i = 0; i < m_ParamItem.size(); i++)
     {
@@ -2827,16 +3998,26 @@ void Query::InitData()
     }
     m_ParamItem.clear();
     m_ParamInitComplete = false;
+    m_nParamsetSize = 1;
+    m_nParamsProcessed = 0;
+    m_ParamStatus.clear();
 
     m_FieldInfo.clear();
+    m_FieldInfo.BuildIndex(m_bFieldNameNoCase);
+    m_ColumnFormat.clear();
+    m_nResultSetId++;
+    m_nFieldCount = -1;
+    m_strStatement.clear();
     m_RowFieldState.clear();
+    UnbindRowset();
+    m_RowStatus.clear();
 #ifdef USE_ROWDATA
     m_RowData.clear();
     m_Init.clear();
 #endif
 }
 
-RETCODE Query::InitFieldInfos()
+RETCODE Query::InitFieldInfos(const tstring* pStatement)
 {
     SQLRETURN nRetCode = SQL_SUCCESS;    //Return code for your ODBC calls
     assert(m_hstmt != SQL_NULL_HSTMT);
@@ -2844,11 +4025,39 @@ RETCODE Query::InitFieldInfos()
     if (m_hstmt == SQL_NULL_HSTMT)
         return SQL_INVALID_HANDLE;  // TODO
 
+    m_nResultSetId++;
+    m_nFieldCount = -1;
     short nFieldCount = GetODBCFieldCount();
     assert(nFieldCount >= 0);
+    m_nFieldCount = nFieldCount;
     if (nFieldCount <= 0)
     {
         m_FieldInfo.clear();
+        m_FieldInfo.BuildIndex(m_bFieldNameNoCase);
+        m_ColumnFormat.clear();
+        return nRetCode;
+    }
+
+    // The first result set of a statement from the statement cache has been described before.
+    bool bPrepared = m_bCachedStatement && pStatement == &m_strStatement;
+    if (bPrepared && m_Prepared.m_bResultInfo && m_Prepared.m_ResultInfo.size() == (size_t) nFieldCount)
+    {
+        m_FieldInfo = m_Prepared.m_ResultInfo;
+        m_FieldInfo.BuildIndex(m_bFieldNameNoCase);
+        nRetCode = BindRowset();
+        BuildColumnFormats();
+        return nRetCode;
+    }
+
+    // The same statement text yields the same columns, unless the schema has changed in between.
+    // The column count serves as a cheap plausibility check.
+    if (pStatement != nullptr && m_pConnection != nullptr
+        && m_pConnection->LookupDescribeCache(*pStatement, m_FieldInfo)
+        && m_FieldInfo.size() == (size_t) nFieldCount)
+    {
+        m_FieldInfo.BuildIndex(m_bFieldNameNoCase);
+        nRetCode = BindRowset();
+        BuildColumnFormats();
         return nRetCode;
     }
 
@@ -2889,17 +4098,128 @@ RETCODE Query::InitFieldInfos()
         m_FieldInfo[col].m_nNullability = nullable;
     }
 
+    m_FieldInfo.BuildIndex(m_bFieldNameNoCase);
+    if (pStatement != nullptr && m_pConnection != nullptr)
+        m_pConnection->StoreDescribeCache(*pStatement, m_FieldInfo);
+    if (bPrepared)
+    {
+        m_Prepared.m_ResultInfo = m_FieldInfo;
+        m_Prepared.m_bResultInfo = true;
+    }
+
+    nRetCode = BindRowset();
+    BuildColumnFormats();
     return nRetCode;
 }
 
-#ifdef USE_ROWDATA
+RETCODE Query::BindRowset()
+{
+    SQLRETURN nRetCode = SQL_SUCCESS;    //Return code for your ODBC calls
+    assert(m_ColumnBinding.empty());
+
+    // Nothing to do unless a block cursor is requested now or was set up for a previous result set.
+    short nFieldCount = (short) m_FieldInfo.size();
+    if (nFieldCount <= 0 || (m_nRowsetSize <= 1 && m_RowStatus.empty()))
+        return nRetCode;
+
+    SQLULEN nRowsetSize = m_nRowsetSize;
+    bool bUnbound = false;
+    for (short col = 0; col < nFieldCount; col++)
+    {
+        const FieldInfo& fi = m_FieldInfo[col];
+        short nCType = FieldInfo::GetDefaultCType(fi);
+        if (ColumnBinding::GetElementSize(nCType) == 0 || (nCType == SQL_C_GUID && fi.m_nSQLType != SQL_GUID))
+            bUnbound = true;
+    }
+
+    if (bUnbound && nRowsetSize > 1)
+    {
+        // The unbound columns are read with SQLGetData() in between the bound ones. This requires
+        // SQL_GD_BLOCK and SQL_GD_ANY_COLUMN, otherwise fall back to fetching single rows.
+        SQLUINTEGER nGetDataExt = 0;
+        nRetCode = ::SQLGetInfo(m_hdbc, SQL_GETDATA_EXTENSIONS, &nGetDataExt, sizeof(nGetDataExt), NULL);
+        if (!SQL_SUCCEEDED(nRetCode) || (nGetDataExt & (SQL_GD_BLOCK | SQL_GD_ANY_COLUMN)) != (SQL_GD_BLOCK | SQL_GD_ANY_COLUMN))
+            nRowsetSize = 1;
+    }
+
+    if (nRowsetSize > 1)
+    {
+        nRetCode = ::SQLSetStmtAttr(m_hstmt, SQL_ATTR_ROW_BIND_TYPE, (SQLPOINTER) SQL_BIND_BY_COLUMN, 0);
+        if (SQL_SUCCEEDED(nRetCode))
+            nRetCode = ::SQLSetStmtAttr(m_hstmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER) nRowsetSize, 0);
+        // The driver may have substituted a smaller value (SQLSTATE 01S02).
+        if (SQL_SUCCEEDED(nRetCode))
+            nRetCode = ::SQLGetStmtAttr(m_hstmt, SQL_ATTR_ROW_ARRAY_SIZE, &nRowsetSize, 0, NULL);
+        if (!SQL_SUCCEEDED(nRetCode))
+            nRowsetSize = 1;
+    }
+
+    if (nRowsetSize <= 1)
+    {
+        // ordinary single row cursor, reset what may be left from a previous result set
+        ::SQLSetStmtAttr(m_hstmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER) 1, 0);
+        ::SQLSetStmtAttr(m_hstmt, SQL_ATTR_ROW_STATUS_PTR, NULL, 0);
+        ::SQLSetStmtAttr(m_hstmt, SQL_ATTR_ROWS_FETCHED_PTR, NULL, 0);
+        m_RowStatus.clear();
+        return SQL_SUCCESS;
+    }
+
+    m_RowStatus.resize(nRowsetSize);
+    nRetCode = ::SQLSetStmtAttr(m_hstmt, SQL_ATTR_ROW_STATUS_PTR, m_RowStatus.data(), 0);
+    if (SQL_SUCCEEDED(nRetCode))
+        nRetCode = ::SQLSetStmtAttr(m_hstmt, SQL_ATTR_ROWS_FETCHED_PTR, &m_nRowsFetched, 0);
+    if (!SQL_SUCCEEDED(nRetCode))
+    {
+        throw DbException(nRetCode, SQL_HANDLE_STMT, m_hstmt);
+        return nRetCode;
+    }
+
+    m_ColumnBinding.resize(nFieldCount, nullptr);
+    for (short col = 0; col < nFieldCount; col++)
+    {
+        const FieldInfo& fi = m_FieldInfo[col];
+        short nCType = FieldInfo::GetDefaultCType(fi);
+        if (ColumnBinding::GetElementSize(nCType) == 0 || (nCType == SQL_C_GUID && fi.m_nSQLType != SQL_GUID))
+            continue;
+
+        ColumnBinding* pBinding = new ColumnBinding(nCType, nRowsetSize);
+        m_ColumnBinding[col] = pBinding;
+        nRetCode = pBinding->Bind(m_hstmt, col + 1);
+        if (!SQL_SUCCEEDED(nRetCode))
+        {
+            throw DbException(nRetCode, SQL_HANDLE_STMT, m_hstmt);
+            return nRetCode;
+        }
+    }
+
+    m_bSetPos = bUnbound;
+    m_nRowsFetched = 0;
+    m_nRowsetPos = 0;
+    return SQL_SUCCESS;
+}
+
+void Query::UnbindRowset()
+{
+    // The driver must not refer to the buffers any more, i.e. SQLFreeStmt(SQL_UNBIND) has been
+    // called or the statement handle has been freed.
+    for (unsigned int i = 0; i < m_ColumnBinding.size(); i++)
+    {
+        if (m_ColumnBinding[i] != nullptr)
+            delete m_ColumnBinding[i];
+        m_ColumnBinding[i] = nullptr;
+    }
+    m_ColumnBinding.clear();
+    m_nRowsFetched = 0;
+    m_nRowsetPos = 0;
+    m_bSetPos = false;
+}
+
 void Query::GetCurrentRow(DataRow& currentRow)
 {
     currentRow.resize(m_FieldInfo.size());
     for (unsigned short col = 0; col < m_FieldInfo.size(); col++)
     {
-        DBItem& item = currentRow[col];
-        GetFieldValue(col, item);
+        // copying keeps the buffers of currentRow's items
+        currentRow[col] = GetRowItem(col);
     }
 }
-#endif
@@ -5,12 +5,21 @@
 #include "fieldinfo.h"
 #include "resultinfo.h"
 #include "paraminfo.h"
+#include "columnbatch.h"
+#include "queryexecutor.h"
 
 #define USE_ROWDATA
 #ifdef USE_ROWDATA
 #include "datarow.h"
 #endif
+#include "rowformatter.h"
 #include <map>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <ostream>
+#include <istream>
 
 using namespace std;
 
@@ -18,6 +27,7 @@ namespace linguversa
 {
     
 class ParamItem;
+class ColumnBinding;
 
 class Query
 {
@@ -46,12 +56,19 @@ public:
 
     // Gets the number of columns in the result set. If there is no result set at all (e.g. insert, update) the
     // function returns 0.
+    // The count is determined once per result set, so it is cheap to call inside loops.
     short GetODBCFieldCount() const;
 
     // Returns the 0-based column index which corresponds to the column named lpszFieldName, 
     // -1 if no column name matches.
+    // The names are looked up in a hash index which is built once per result set.
     int GetFieldIndexByName(tstring lpszFieldName) const;
 
+    // If bNoCase is true, column names are compared case-insensitively by all functions
+    // which take a column name. The default is false (case-sensitive).
+    void SetFieldNameNoCase(bool bNoCase);
+    bool GetFieldNameNoCase() const { return m_bFieldNameNoCase; };
+
     // Retrieves information about column type and size. See Visual Studio / MFC help for further information 
     // on CODBCFieldInfo.
     void GetODBCFieldInfo( short nIndex, FieldInfo& fieldinfo) const;
@@ -59,6 +76,8 @@ public:
     // Retrieves information about column name, type and size. See Visual Studio / MFC help for further information 
     // on CODBCFieldInfo. Returns false if no column with the specified column name exists.
     bool GetODBCFieldInfo( tstring lpszName, FieldInfo& fieldinfo) const ;
+    // The columns of the current result set, e.g. to compile a RowFormatter.
+    const ResultInfo& GetResultInfo() const { return m_FieldInfo; };
 
     // Some engines (like SQLite) do not always know the complete Fieldinfo. 
     // In those cases the application program should know and 
@@ -79,7 +98,49 @@ public:
     //       return true instead of SQL_SUCCESS and false instead of SQL_NO_DATA_FOUND.
     SQLRETURN Fetch();
 
-    void Cancel();
+    // Block cursor: let the driver deliver up to nRowsetSize rows with each SQLFetch instead of one.
+    // Fixed length columns (numbers, timestamps, guids) are then bound column-wise to internal arrays,
+    // character and binary columns are still read with SQLGetData (if the driver supports SQLGetData
+    // within a block cursor, otherwise the query silently falls back to single row fetching).
+    // Fetch() and GetFieldValue() work as before, they walk through the rowset in memory.
+    // Bound columns are always delivered in their default C type, so GetFieldValue() with an explicit
+    // C type other than FieldInfo::GetDefaultCType() will not convert them.
+    // Must be set before ExecDirect() or Execute(); the default 1 means one row per SQLFetch.
+    void SetRowsetSize(SQLULEN nRowsetSize);
+    SQLULEN GetRowsetSize() const { return m_nRowsetSize; };
+
+    // Fetches up to nMaxRows rows into the typed column arrays of batch, which is set up for the current
+    // result set if necessary. Returns the number of rows fetched, 0 if there are no more rows.
+    // The values are read from the driver (or the rowset buffers, see SetRowsetSize()) directly into the batch,
+    // without DBItem; GetFieldValue() cannot be used for the rows fetched this way.
+    size_t FetchBatch(ColumnBatch& batch, size_t nMaxRows);
+
+    // Cancel the function executing on the statement (SQLCancel). May be called from another thread;
+    // the cancelled function fails with SQLSTATE HY008 and the query can be used again afterwards.
+    // If no function is executing, the next Fetch() or FetchBatch() throws with SQLSTATE HY008.
+    SQLRETURN Cancel();
+    // true if Cancel() has been called since the last ExecDirect(), Execute() or SetDeadline()
+    bool IsCancelled() const { return m_bCancelled; };
+
+    // Timeout in seconds for the statements of this query (SQL_ATTR_QUERY_TIMEOUT), enforced by the driver
+    // resp. the server. 0 means no timeout; by default the timeout of the Connection applies.
+    void SetQueryTimeout(SQLULEN nSeconds);
+    // Let the Watchdog cancel the statement if it is still executing or fetching at deadline, also for
+    // drivers which ignore SQL_ATTR_QUERY_TIMEOUT. Applies until ClearDeadline(), Close() or destruction.
+    void SetDeadline(std::chrono::steady_clock::time_point deadline);
+    void SetDeadline(std::chrono::milliseconds timeout) { SetDeadline(std::chrono::steady_clock::now() + timeout); };
+    void ClearDeadline();
+
+    // Asynchronous versions of ExecDirect() and Fetch(), executed on a QueryExecutor (see queryexecutor.h).
+    // If the driver supports asynchronous execution on statement level, the ODBC call is started with 
+    // SQL_ATTR_ASYNC_ENABLE and polled, so that a few executor threads serve many statements at a time.
+    // Otherwise, and if data-at-execution parameters are bound, the blocking call runs on an executor thread.
+    // The query must not be used otherwise before the result is ready; exceptions are rethrown by
+    // AsyncResult::Get() resp. co_await.
+    AsyncResult ExecDirectAsync(QueryExecutor& executor, tstring statement);
+    AsyncResult FetchAsync(QueryExecutor& executor);
+    // true if the driver reports SQL_AM_STATEMENT for SQL_ASYNC_MODE
+    bool SupportsAsync();
 
     // ODBC allows multiple result sets for one query. After reading the last row of a result set 
     // SQLMoreResults() asks whether there is another result set pending. 
@@ -135,6 +196,16 @@ public:
     void GetFieldValue( short nIndex, DBItem& varValue, short nFieldType = DEFAULT_FIELD_TYPE);
     bool GetFieldValue( tstring lpszName, DBItem& varValue, short nFieldType = DEFAULT_FIELD_TYPE);
 
+    // Read a long character or binary column in chunks of nChunkSize bytes and hand each chunk to
+    // callback resp. write it to os, so that BLOBs and long texts are never held in memory as a whole.
+    // nCType is SQL_C_BINARY, SQL_C_CHAR or SQL_C_WCHAR; the chunks contain no terminating zeros.
+    // Returns the total number of bytes or SQL_NULL_DATA. SQLGetData() can read a column only once,
+    // so afterwards GetFieldValue() returns null for this column in the current row.
+    // Values that have already been read or that are bound are delivered from memory.
+    SQLLEN StreamFieldValue( short nIndex, const std::function<void(const unsigned char*, size_t)>& callback,
+        SQLSMALLINT nCType = SQL_C_BINARY, size_t nChunkSize = 65536);
+    SQLLEN StreamFieldValue( short nIndex, std::ostream& os, SQLSMALLINT nCType = SQL_C_BINARY, size_t nChunkSize = 65536);
+
     // If true the data field in the current row has been read and value or null indicator is initialized.
     bool IsFieldInit( short nIndex);
     bool IsFieldInit( tstring lpszName);
@@ -147,14 +218,36 @@ public:
     // TODO: format the value of the specified column as string, according to its FieldInfo.
     tstring FormatFieldValue( short nIndex);
     tstring FormatFieldValue( tstring lpszName);
+    // Same for a value of column nIndex copied by GetCurrentRow().
+    tstring FormatFieldValue( short nIndex, const DBItem& varValue) const;
+
+    // The compiled formats of the columns of the current result set, as used by FormatFieldValue().
+    // A copy taken before the first Fetch() lets other threads format the values copied by GetCurrentRow()
+    // without touching the query, which the fetching thread keeps changing.
+    struct ColumnFormat
+    {
+        signed short m_nCType;              // C type the formatters have been compiled for
+        bool m_bCTypeFormat;                // a format of SetCTypeFormat() applies to all values
+        bool m_bDefaultCType;               // m_nCType is the default C type of the column
+        ColumnFormatter m_Formatter;        // format of SetCTypeFormat() or default format
+        ColumnFormatter m_DecimalFormatter; // FieldInfo::GetDefaultFormat() for float and double values
+    };
+    const vector<ColumnFormat>& GetColumnFormats() const { return m_ColumnFormat; };
+    static tstring FormatColumnValue( const ColumnFormat& columnformat, const DBItem& varValue);
 
     // formatting of output
     tstring FormatCurrentRow(const std::tstring);
+    tstring FormatRow(const DataRow& row, const std::tstring fmt) const;
+    // Append the current row to text, formatted by a RowFormatter compiled for the current result set.
+    void FormatCurrentRow(const RowFormatter& formatter, tstring& text);
 
     // Set an arbitrary SQL statement which is to be executed. 
     // The statement may contain question marks as placeholders for variables which have to 
     // be bound to the statement according to their types and the sql type in the statement. 
     // For details see the conversion matrix in Visual Studio help.
+    // If the statement cache of the connection is enabled (Connection::SetStatementCacheSize) and the query
+    // has no statement handle yet or one from the cache, an already prepared handle is taken from the cache.
+    // Close(), ExecDirect() and the next Prepare() return it; the parameters must be bound again in any case.
     SQLRETURN Prepare(tstring statement);
 
     // Execute the statement which was previously set with Prepare(). 
@@ -225,6 +318,63 @@ public:
 	// corresponding stored proc parameter.
 	// For inouttype = ParamInfo::input bufParamlen can be omitted and it will be used 0 or, if positive, the value of paramDataLen.
 	RETCODE BindParameter(SQLUSMALLINT ParameterNumber, BYTE* pBa, SQLLEN paramDataLen, SQLLEN paramBufLen = 0, ParamInfo::InputOutputType inouttype = ParamInfo::unknown);
+	// Data-at-execution input parameter: the value is not held in a buffer but sent in chunks with SQLPutData()
+	// while Execute() or ExecDirect() runs, so large documents or images need only constant memory.
+	// producer fills the buffer with the next chunk and returns its length in bytes, 0 at the end of the value.
+	// The stream variant reads the value from is up to its end; rewind or bind again before the next Execute().
+	// nLength is the total length in bytes if known; some drivers require it (SQL_NEED_LONG_DATA_LEN).
+	// nCType is SQL_C_BINARY, SQL_C_CHAR or SQL_C_WCHAR; a chunk of wide characters must not split a character.
+	RETCODE BindParameter(SQLUSMALLINT ParameterNumber, const std::function<size_t(unsigned char*, size_t)>& producer,
+		SQLLEN nLength = SQL_NO_TOTAL, SQLSMALLINT nCType = SQL_C_BINARY);
+	RETCODE BindParameter(SQLUSMALLINT ParameterNumber, std::istream& is, SQLLEN nLength = SQL_NO_TOTAL, SQLSMALLINT nCType = SQL_C_BINARY);
+	// size of the chunks passed to SQLPutData(), default 64 KB
+	void SetPutDataChunkSize(size_t nChunkSize) { m_nPutDataChunkSize = nChunkSize > 256 ? nChunkSize : 256; };
+
+	// Parameter arrays: Execute() (or ExecDirect()) sends nParamsetSize sets of parameters in one call instead
+	// of one call per row. All parameters must then be bound with BindParameterArray() to arrays of at least
+	// nParamsetSize elements. nParamsetSize = 1 returns to single parameter values.
+	SQLRETURN SetParamsetSize(SQLULEN nParamsetSize);
+	SQLULEN GetParamsetSize() const { return m_nParamsetSize; };
+	// After Execute(): number of parameter sets processed and status of each one (0-based), i.e. SQL_PARAM_SUCCESS,
+	// SQL_PARAM_SUCCESS_WITH_INFO, SQL_PARAM_ERROR, SQL_PARAM_UNUSED or SQL_PARAM_DIAG_UNAVAILABLE.
+	SQLULEN GetParamsProcessed() const { return m_nParamsProcessed; };
+	SQLUSMALLINT GetParamStatus(SQLULEN nRow) const;
+
+	// Bind an array of host variables with one element for each parameter set. The arrays must stay valid until
+	// the statement has been executed. pLenInd is an optional array of length/indicator values of the same size,
+	// e.g. SQL_NULL_DATA for null values; without it all values are non-null.
+	RETCODE BindParameterArray(SQLUSMALLINT ParameterNumber, short* pArray, SQLLEN* pLenInd = nullptr, ParamInfo::InputOutputType inouttype = ParamInfo::unknown);
+	RETCODE BindParameterArray(SQLUSMALLINT ParameterNumber, int* pArray, SQLLEN* pLenInd = nullptr, ParamInfo::InputOutputType inouttype = ParamInfo::unknown);
+	RETCODE BindParameterArray(SQLUSMALLINT ParameterNumber, long* pArray, SQLLEN* pLenInd = nullptr, ParamInfo::InputOutputType inouttype = ParamInfo::unknown);
+	RETCODE BindParameterArray(SQLUSMALLINT ParameterNumber, unsigned ODBCINT64* pArray, SQLLEN* pLenInd = nullptr, ParamInfo::InputOutputType inouttype = ParamInfo::unknown);
+	RETCODE BindParameterArray(SQLUSMALLINT ParameterNumber, double* pArray, SQLLEN* pLenInd = nullptr, ParamInfo::InputOutputType inouttype = ParamInfo::unknown);
+	RETCODE BindParameterArray(SQLUSMALLINT ParameterNumber, TIMESTAMP_STRUCT* pArray, SQLLEN* pLenInd = nullptr, ParamInfo::InputOutputType inouttype = ParamInfo::unknown);
+	RETCODE BindParameterArray(SQLUSMALLINT ParameterNumber, SQLGUID* pArray, SQLLEN* pLenInd = nullptr, ParamInfo::InputOutputType inouttype = ParamInfo::unknown);
+	// Contiguous buffer of TCHAR strings with nElementLen TCHARs per element (including the terminating 0).
+	// Without pLenInd all strings must be null terminated.
+	RETCODE BindParameterArray(SQLUSMALLINT ParameterNumber, TCHAR* pBuf, SQLLEN nElementLen, SQLLEN* pLenInd = nullptr, ParamInfo::InputOutputType inouttype = ParamInfo::unknown);
+	// Contiguous buffer of binary values with nElementLen bytes per element. pLenInd is mandatory and holds
+	// the data length of each element in bytes or SQL_NULL_DATA.
+	RETCODE BindParameterArray(SQLUSMALLINT ParameterNumber, BYTE* pBuf, SQLLEN nElementLen, SQLLEN* pLenInd, ParamInfo::InputOutputType inouttype = ParamInfo::unknown);
+	// Convenience overloads for vectors; they also set the paramset size to the size of the vector.
+	// All vectors bound for the same Execute() must have the same size.
+	template<typename T>
+	RETCODE BindParameterArray(SQLUSMALLINT ParameterNumber, std::vector<T>& values, std::vector<SQLLEN>* pLenInd = nullptr, ParamInfo::InputOutputType inouttype = ParamInfo::unknown)
+	{
+		if (pLenInd != nullptr && pLenInd->size() < values.size())
+			return SQL_ERROR;
+		if (values.size() != m_nParamsetSize)
+			SetParamsetSize(values.size());
+		return BindParameterArray(ParameterNumber, values.data(), pLenInd ? pLenInd->data() : nullptr, inouttype);
+	}
+
+	// Counterpart of FetchBatch(): bind the columns of batch as parameter arrays 1 ... n and execute the
+	// prepared statement once for all its rows, e.g. an "insert into t(a, b) values (?, ?)".
+	// Character and binary columns are copied into fixed size slots, all other columns are bound directly.
+	// If the driver reports SQL_PARAM_ERROR for any row, a DbException is thrown even if Execute() succeeded
+	// with info; GetParamStatus() then tells which rows have failed.
+	RETCODE ExecuteBatch(const ColumnBatch& batch);
+
 	// Because ParamInfo does not include the actual paramDataLenth, we need a function to retrieve the data length of inout and output parameters
 	// after execution.
 	SQLLEN GetParamDataLength(SQLUSMALLINT ParameterNumber);
@@ -258,24 +408,141 @@ protected:
     ResultInfo m_FieldInfo;
     vector<ParamItem*> m_ParamItem;
     std::map<signed short, tstring> m_CTypeFormat;
+    // Formatters of the columns of the current result set, compiled once from m_CTypeFormat
+    // and the field infos, so that FormatFieldValue() needs no lookup and no parsing per value.
+    vector<ColumnFormat> m_ColumnFormat;
+    void BuildColumnFormats();
+    // the C type in which GetFieldValue(nIndex) delivers the column, see ReadFieldValue()
+    signed short GetReadCType(short nIndex) const;
     // If true map named params to the corresponding positional parameter,
     // otherwise append at the end of m_ParamItem regardless of ordinal position in signature.
     bool m_ParamInitComplete;
 
     void InitData();
-    RETCODE InitFieldInfos();
+    // allocate m_hstmt and apply the query timeout
+    SQLRETURN AllocStatement();
+    void ApplyQueryTimeout();
+    // Return m_hstmt to the state after SQLPrepare: no cursor, no bound columns or parameters,
+    // and no statement attributes pointing into this query.
+    SQLRETURN DetachStatement();
+    // m_hstmt belongs to the statement cache of the connection and goes back there instead of being freed
+    bool m_bCachedStatement;
+    Connection::PreparedStatement m_Prepared;   // descriptions of the cached statement
+    void ReleaseCachedStatement();
+    // -1: the timeout of the connection applies
+    long m_nQueryTimeout;
+    std::atomic<bool> m_bCancelled;
+    bool m_bWatched;
+    // Cancel() may run on another thread, e.g. the Watchdog's: m_hstmt is only changed under this lock,
+    // and a handle leaves the query only through TakeStatementHandle().
+    std::mutex m_HandleMutex;
+    void SetStatementHandle(HSTMT hstmt);
+    HSTMT TakeStatementHandle();
+    // the parts of ExecDirect() before and after SQLExecDirect
+    SQLRETURN ResetStatement();
+    SQLRETURN EndExecDirect(SQLRETURN nRetCode, const tstring& statement);
+    // send the values of data-at-execution parameters while SQLExecute/SQLExecDirect return SQL_NEED_DATA
+    SQLRETURN PutParamData(SQLRETURN nRetCode);
+    size_t m_nPutDataChunkSize;
+    // clear the values of the current row before fetching the next one
+    void ResetRowData();
+    SQLRETURN SetAsyncEnable(bool bEnable);
+    // SQL_ASYNC_MODE of the driver, -1 if not yet determined
+    int m_nAsyncMode;
+    // Describe the columns of the current result set. If pStatement is given, the shape may be taken
+    // from the connection's describe cache instead (see Connection::SetDescribeCacheSize).
+    RETCODE InitFieldInfos(const tstring* pStatement = nullptr);
+    // number of result columns, -1 if not yet determined
+    short m_nFieldCount;
+    // statement text of the last Prepare()
+    tstring m_strStatement;
+    // Read the value of the current row with SQLGetData (or from the rowset buffer) into varValue.
+    void ReadFieldValue(short nIndex, DBItem& varValue, short nFieldType);
     bytearray m_RowFieldState; // 0x01: initialized, 0x02: null value
 
-#ifdef USE_ROWDATA
+    // parameter arrays
+    SQLULEN m_nParamsetSize;
+    SQLULEN m_nParamsProcessed;
+    vector<SQLUSMALLINT> m_ParamStatus;
+    vector<bytearray> m_BatchData;          // fixed size slots of the character and binary columns in ExecuteBatch()
+    vector<vector<SQLLEN>> m_BatchLenInd;   // length / indicator arrays of ExecuteBatch()
+    RETCODE BindParamArray(SQLUSMALLINT ParameterNumber, SQLSMALLINT nCType, SQLSMALLINT nDefaultSqlType,
+        void* pArray, SQLLEN nElementSize, SQLLEN* pLenInd, ParamInfo::InputOutputType inouttype);
+
+    bool m_bFieldNameNoCase;
+    // incremented whenever m_FieldInfo changes, see ColumnHandle
+    unsigned int m_nResultSetId;
+
+    // block cursor
+    SQLULEN m_nRowsetSize;    // requested number of rows per SQLFetch
+    SQLULEN m_nRowsFetched;   // number of rows delivered by the last SQLFetch
+    SQLULEN m_nRowsetPos;     // 0-based position of the current row within the rowset
+    vector<SQLUSMALLINT> m_RowStatus;
+    vector<ColumnBinding*> m_ColumnBinding; // nullptr for columns read with SQLGetData
+    bool m_bSetPos;           // position the cursor within the rowset before SQLGetData
+    RETCODE BindRowset();
+    void UnbindRowset();
+    void FetchBatchValue(short nIndex, ColumnVector& cv);
+
+    // Read a character or binary column with as few SQLGetData calls as possible into buf, starting at nStart;
+    // nTerm is the size of the terminating zero the driver appends (0 for binary data).
+    // On return len is the length of the value in bytes or SQL_NULL_DATA, buf holds at least nStart + len bytes.
+    SQLRETURN GetLongData(short nIndex, SQLSMALLINT nCType, size_t nTerm, bytearray& buf, size_t nStart, SQLLEN& len);
+    bytearray m_Scratch;    // reusable buffer for GetLongData(), grows to the largest value read
+
 public:
     // Retrieve whole row into an array of DBItems (after previous Fetch().
     void GetCurrentRow( DataRow& currentRow);
+
 protected:
+    // Cached value of the current row, read on first access.
+    // Without USE_ROWDATA the value is read into m_FieldItem, which holds only the last value read.
+    const DBItem& GetRowItem(short nIndex, short nFieldType = DEFAULT_FIELD_TYPE);
+
+#ifdef USE_ROWDATA
+public:
+    // Long strings and binary values of the current row are allocated from an arena owned by the query,
+    // which is reset by each Fetch(). This avoids heap fragmentation and allocator contention when
+    // several threads fetch at the same time. Values copied by GetFieldValue() are not affected.
+    void UseArena(bool bUseArena = true);
+    // Alternatively allocate the values of the current row from a user supplied resource, e.g. a
+    // std::pmr::unsynchronized_pool_resource. nullptr (the default) means new/delete.
+    void SetMemoryResource(MemoryResource* pResource);
+protected:
+    ArenaResource m_Arena;  // declared before m_RowData, which may allocate from it
     DataRow m_RowData;
     vector<bool> m_Init;
+#else
+    DBItem m_FieldItem;
 #endif
 
     friend class QueryException;
+    friend class ColumnHandle;
+};
+
+// Resolves a column name only once per result set, so that access by name costs
+// the same as access by index. A ColumnHandle converts to the column index and can be
+// used with all functions which take a short nIndex:
+//     ColumnHandle hName(query, _T("name"));
+//     while (query.Fetch() != SQL_NO_DATA_FOUND)
+//         query.GetFieldValue(hName, sName);
+// If there is no column of that name the index is -1.
+class ColumnHandle
+{
+public:
+    ColumnHandle(const Query& query, tstring lpszFieldName);
+
+    short GetIndex() const;
+    operator short() const { return GetIndex(); };
+    bool IsValid() const { return GetIndex() >= 0; };
+    const tstring& GetName() const { return m_strName; };
+
+protected:
+    const Query* m_pQuery;
+    tstring m_strName;
+    // resolved index and the result set it belongs to
+    mutable short m_nIndex;
+    mutable unsigned int m_nResultSetId;
 };
 
 class QueryException : public DbException
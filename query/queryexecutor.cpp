@@ -0,0 +1,150 @@
+#include "queryexecutor.h"
+#include <chrono>
+
+using namespace linguversa;
+using namespace std;
+
+bool AsyncResult::IsReady() const
+{
+    lock_guard<mutex> lock(m_pState->mutex);
+    return m_pState->bReady;
+}
+
+SQLRETURN AsyncResult::Get() const
+{
+    unique_lock<mutex> lock(m_pState->mutex);
+    m_pState->ready.wait(lock, [this] { return m_pState->bReady; });
+    if (m_pState->error)
+        rethrow_exception(m_pState->error);
+    return m_pState->nRetCode;
+}
+
+void AsyncResult::Then(function<void()> continuation)
+{
+    if (!SetContinuation(continuation))
+        continuation();
+}
+
+bool AsyncResult::SetContinuation(function<void()> continuation)
+{
+    lock_guard<mutex> lock(m_pState->mutex);
+    if (m_pState->bReady)
+        return false;
+    m_pState->continuation = std::move(continuation);
+    return true;
+}
+
+void AsyncResult::Complete(SQLRETURN nRetCode, exception_ptr error)
+{
+    function<void()> continuation;
+    {
+        lock_guard<mutex> lock(m_pState->mutex);
+        m_pState->nRetCode = nRetCode;
+        m_pState->error = error;
+        m_pState->bReady = true;
+        continuation.swap(m_pState->continuation);
+    }
+    m_pState->ready.notify_all();
+    if (continuation)
+        continuation();
+}
+
+QueryExecutor::QueryExecutor(size_t nThreads, unsigned int nPollIntervalMs)
+    : m_Pool(nThreads)
+{
+    m_nPollIntervalMs = nPollIntervalMs;
+    m_nPending = 0;
+    m_bStop = false;
+    m_Timer = thread(&QueryExecutor::RunTimer, this);
+}
+
+QueryExecutor::~QueryExecutor()
+{
+    {
+        unique_lock<mutex> lock(m_Mutex);
+        m_Changed.wait(lock, [this] { return m_nPending == 0; });
+        m_bStop = true;
+    }
+    m_Changed.notify_all();
+    m_Timer.join();
+}
+
+AsyncResult QueryExecutor::Poll(function<SQLRETURN()> operation)
+{
+    return Submit(std::move(operation), true);
+}
+
+AsyncResult QueryExecutor::Run(function<SQLRETURN()> operation)
+{
+    return Submit(std::move(operation), false);
+}
+
+size_t QueryExecutor::GetPendingCount() const
+{
+    lock_guard<mutex> lock(m_Mutex);
+    return m_nPending;
+}
+
+AsyncResult QueryExecutor::Submit(function<SQLRETURN()> operation, bool bPoll)
+{
+    shared_ptr<Operation> pOperation = make_shared<Operation>();
+    pOperation->function = std::move(operation);
+    pOperation->bPoll = bPoll;
+    {
+        lock_guard<mutex> lock(m_Mutex);
+        m_nPending++;
+    }
+    m_Pool.Submit([this, pOperation]() { Step(pOperation); });
+    return pOperation->result;
+}
+
+void QueryExecutor::Step(shared_ptr<Operation> pOperation)
+{
+    SQLRETURN nRetCode = SQL_ERROR;
+    exception_ptr error;
+    try
+    {
+        nRetCode = pOperation->function();
+    }
+    catch (...)
+    {
+        error = current_exception();
+    }
+
+    if (!error && nRetCode == SQL_STILL_EXECUTING && pOperation->bPoll)
+    {
+        {
+            lock_guard<mutex> lock(m_Mutex);
+            m_Waiting.push_back(pOperation);
+        }
+        m_Changed.notify_all();
+        return;
+    }
+
+    pOperation->result.Complete(nRetCode, error);
+
+    // notify under the lock: afterwards the destructor may run
+    lock_guard<mutex> lock(m_Mutex);
+    m_nPending--;
+    m_Changed.notify_all();
+}
+
+void QueryExecutor::RunTimer()
+{
+    unique_lock<mutex> lock(m_Mutex);
+    for (;;)
+    {
+        m_Changed.wait(lock, [this] { return m_bStop || !m_Waiting.empty(); });
+        if (m_bStop)
+            return;
+
+        // give the driver some time before the next call
+        m_Changed.wait_for(lock, chrono::milliseconds(m_nPollIntervalMs), [this] { return m_bStop; });
+        vector<shared_ptr<Operation>> waiting;
+        waiting.swap(m_Waiting);
+        lock.unlock();
+        for (shared_ptr<Operation>& pOperation : waiting)
+            m_Pool.Submit([this, pOperation]() { Step(pOperation); });
+        lock.lock();
+    }
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "threadpool.h"
+#include <sql.h>
+
+#include <vector>
+#include <memory>
+#include <functional>
+#include <exception>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#define LV_HAS_COROUTINES 1
+#endif
+#endif
+
+namespace linguversa
+{
+    // Result of an asynchronous operation, e.g. Query::ExecDirectAsync(): the return code of the ODBC
+    // function or the exception thrown by it. Copies refer to the same result.
+    // Wait for it with Get(), register a continuation with Then(), or in a C++20 coroutine:
+    //     SQLRETURN nRetCode = co_await query.ExecDirectAsync(executor, _T("select ..."));
+    // The continuation - resp. the rest of the coroutine - runs on a thread of the QueryExecutor.
+    class AsyncResult
+    {
+    public:
+        AsyncResult() : m_pState(std::make_shared<State>()) {};
+
+        bool IsReady() const;
+        // Blocks until the result is ready; rethrows the exception of the operation.
+        SQLRETURN Get() const;
+        // Calls continuation as soon as the result is ready, immediately if it is ready already.
+        void Then(std::function<void()> continuation);
+
+#ifdef LV_HAS_COROUTINES
+        bool await_ready() const { return IsReady(); };
+        bool await_suspend(std::coroutine_handle<> handle) { return SetContinuation([handle]() { handle.resume(); }); };
+        SQLRETURN await_resume() const { return Get(); };
+#endif
+
+    protected:
+        struct State
+        {
+            std::mutex mutex;
+            std::condition_variable ready;
+            bool bReady = false;
+            SQLRETURN nRetCode = SQL_SUCCESS;
+            std::exception_ptr error;
+            std::function<void()> continuation;
+        };
+        std::shared_ptr<State> m_pState;
+
+        // false if the result is ready already, then continuation is not stored
+        bool SetContinuation(std::function<void()> continuation);
+        void Complete(SQLRETURN nRetCode, std::exception_ptr error);
+
+        friend class QueryExecutor;
+    };
+
+    // Runs the asynchronous operations of many queries on a few threads.
+    // Poll() calls an operation again and again - other operations run in between - until it no longer 
+    // returns SQL_STILL_EXECUTING, so a statement executed by the driver in asynchronous mode does not block
+    // a thread while the server works. Run() is for blocking calls, e.g. of drivers without asynchronous mode.
+    class QueryExecutor
+    {
+    public:
+        explicit QueryExecutor(size_t nThreads = 2, unsigned int nPollIntervalMs = 1);
+        // Waits until all operations are complete.
+        ~QueryExecutor();
+        QueryExecutor(const QueryExecutor&) = delete;
+        QueryExecutor& operator = (const QueryExecutor&) = delete;
+
+        AsyncResult Poll(std::function<SQLRETURN()> operation);
+        AsyncResult Run(std::function<SQLRETURN()> operation);
+
+        // operations which are not complete yet
+        size_t GetPendingCount() const;
+
+    protected:
+        struct Operation
+        {
+            std::function<SQLRETURN()> function;
+            AsyncResult result;
+            bool bPoll;
+        };
+
+        ThreadPool m_Pool;
+        unsigned int m_nPollIntervalMs;
+        mutable std::mutex m_Mutex;
+        std::condition_variable m_Changed;
+        std::vector<std::shared_ptr<Operation>> m_Waiting;  // returned SQL_STILL_EXECUTING, to be called again
+        size_t m_nPending;
+        bool m_bStop;
+        std::thread m_Timer;
+
+        AsyncResult Submit(std::function<SQLRETURN()> operation, bool bPoll);
+        void Step(std::shared_ptr<Operation> pOperation);
+        // resubmits the waiting operations every m_nPollIntervalMs milliseconds
+        void RunTimer();
+    };
+}
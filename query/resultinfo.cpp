@@ -1,19 +1,49 @@
 #include "resultinfo.h"
+#include "lvstring.h"
 
 using namespace std;
 using namespace linguversa;
 
+ResultInfo::ResultInfo()
+{
+	m_nIndexedSize = 0;
+	m_bNoCase = false;
+}
+
 int ResultInfo::GetSqlColumn(tstring colname) const
 {
 	if (colname.length() == 0)
 		return -1;
 
+	if (m_bNoCase)
+		colname = lower(colname);
+
+	if (m_nIndexedSize > 0 && m_nIndexedSize == vector<FieldInfo>::size())
+	{
+		unordered_map<tstring, int>::const_iterator it = m_NameIndex.find(colname);
+		return (it != m_NameIndex.end()) ? it->second : -1;
+	}
+
 	for (unsigned int sqlcol = 0; sqlcol < vector<FieldInfo>::size(); sqlcol++)
 	{
-		if ((*this)[sqlcol].m_strName == colname) // TODO CompareNoCase
+		const tstring& name = (*this)[sqlcol].m_strName;
+		if ((m_bNoCase ? lower(name) : name) == colname)
 			return sqlcol;
 	}
 
 	return -1;
 }
 
+void ResultInfo::BuildIndex(bool bNoCase)
+{
+	m_bNoCase = bNoCase;
+	m_NameIndex.clear();
+	m_NameIndex.reserve(vector<FieldInfo>::size());
+	for (unsigned int sqlcol = 0; sqlcol < vector<FieldInfo>::size(); sqlcol++)
+	{
+		const tstring& name = (*this)[sqlcol].m_strName;
+		// emplace does not overwrite, so the first of several equally named columns wins
+		m_NameIndex.emplace(bNoCase ? lower(name) : name, (int) sqlcol);
+	}
+	m_nIndexedSize = vector<FieldInfo>::size();
+}
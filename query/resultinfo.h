@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include <unordered_map>
 #include "fieldinfo.h"
 
 namespace linguversa
@@ -8,6 +9,22 @@ namespace linguversa
     class ResultInfo : public std::vector<FieldInfo>
     {
     public:
-        int GetSqlColumn(std::tstring colname) const;        
+        ResultInfo();
+
+        // Returns the 0-based index of the column named colname, -1 if no column name matches.
+        // Uses the hash index built by BuildIndex(), or compares linearly if there is none
+        // or the number of columns has changed since.
+        int GetSqlColumn(std::tstring colname) const;
+
+        // Build a hash index over the column names, to be called again whenever column names change.
+        // If bNoCase is true, column names are compared case-insensitively. If several columns have the
+        // same name the first one is found.
+        void BuildIndex(bool bNoCase = false);
+        bool IsNoCase() const { return m_bNoCase; };
+
+    protected:
+        std::unordered_map<std::tstring, int> m_NameIndex;
+        size_t m_nIndexedSize;
+        bool m_bNoCase;
     };
 }
@@ -34,25 +34,25 @@ std::tostream& linguversa::operator<<(std::tostream& ar, const DBItem& item)
         ar << item.m_dblVal;
         break;
     case DBItem::lwvt_date:
-        ar << (item.m_pdate ? item.m_pdate->year : (SQLSMALLINT)0);
-        ar << (item.m_pdate ? item.m_pdate->month : (SQLUSMALLINT)0);
-        ar << (item.m_pdate ? item.m_pdate->day : (SQLUSMALLINT)0);
-        ar << (item.m_pdate ? item.m_pdate->hour : (SQLUSMALLINT)0);
-        ar << (item.m_pdate ? item.m_pdate->minute : (SQLUSMALLINT)0);
-        ar << (item.m_pdate ? item.m_pdate->second : (SQLUSMALLINT)0);
-        ar << (item.m_pdate ? item.m_pdate->fraction : (SQLUINTEGER)0);
+        ar << item.m_dateVal.year;
+        ar << item.m_dateVal.month;
+        ar << item.m_dateVal.day;
+        ar << item.m_dateVal.hour;
+        ar << item.m_dateVal.minute;
+        ar << item.m_dateVal.second;
+        ar << item.m_dateVal.fraction;
         break;
     case DBItem::lwvt_string:
-        ar << (item.m_pstring ? *item.m_pstring : (tstring)_T(""));
+        ar << item.GetString();
         break;
     case DBItem::lwvt_wstring:
         #ifdef UNICODE
-        ar << (item.m_pstringw ? *item.m_pstringw : (wstring)L"");
+        ar << item.GetStringW();
         #endif
         break;
     case DBItem::lwvt_astring:
         #ifndef UNICODE
-        ar << (item.m_pstringa ? *item.m_pstringa : (string)"");
+        ar << item.GetStringA();
         #endif
         break;
     case DBItem::lwvt_binary:
@@ -61,21 +61,16 @@ std::tostream& linguversa::operator<<(std::tostream& ar, const DBItem& item)
         break;
     case DBItem::lwvt_bytearray:
     {
-        bytearray* pByteArray = (bytearray*)item.m_pByteArray;
-        if (pByteArray == nullptr)
-            pByteArray = new bytearray();
-        bytearray& ba = *pByteArray;
-        ar << ba.size();
-        for (size_t i = 0; i < ba.size(); i++)
+        const unsigned char* ba = item.GetData();
+        ar << item.GetDataLength();
+        for (size_t i = 0; i < item.GetDataLength(); i++)
         {
             ar << ba[i];
         }
-        if (item.m_pByteArray == nullptr)
-            delete pByteArray;
     }
     break;
     case DBItem::lwvt_uint64:
-        ar << (item.m_pUInt64 ? (*item.m_pUInt64) : (UINT64)0);
+        ar << item.m_ui64Val;
         break;
     default:
         assert(false);
@@ -125,33 +120,37 @@ std::tistream& linguversa::operator>>(std::tistream& ar, DBItem& var)
         ar >> var.m_dblVal;
         break;
     case DBItem::lwvt_date:
-        if (var.m_pdate == nullptr || var.m_nVarType != vt)
-            var.m_pdate = new TIMESTAMP_STRUCT();
-        ar >> var.m_pdate->year;
-        ar >> var.m_pdate->month;
-        ar >> var.m_pdate->day;
-        ar >> var.m_pdate->hour;
-        ar >> var.m_pdate->minute;
-        ar >> var.m_pdate->second;
-        ar >> var.m_pdate->fraction;
+        ar >> var.m_dateVal.year;
+        ar >> var.m_dateVal.month;
+        ar >> var.m_dateVal.day;
+        ar >> var.m_dateVal.hour;
+        ar >> var.m_dateVal.minute;
+        ar >> var.m_dateVal.second;
+        ar >> var.m_dateVal.fraction;
         break;
     case DBItem::lwvt_string:
-        if (var.m_pstring == nullptr || var.m_nVarType != vt)
-            var.m_pstring = new tstring();
-        ar >> (*var.m_pstring);
+    {
+        tstring str;
+        ar >> str;
+        var.SetString(str);
+    }
         break;
     case DBItem::lwvt_wstring:
         #ifdef UNICODE
-        if (var.m_pstringw == nullptr || var.m_nVarType != vt)
-            var.m_pstringw = new wstring();
-        ar >> (*var.m_pstringw);
+        {
+            wstring str;
+            ar >> str;
+            var.SetStringW(str.c_str(), str.size());
+        }
         #endif
         break;
     case DBItem::lwvt_astring:
         #ifndef UNICODE
-        if (var.m_pstringa == nullptr || var.m_nVarType != vt)
-            var.m_pstringa = new string();
-        ar >> (*var.m_pstringa);
+        {
+            string str;
+            ar >> str;
+            var.SetStringA(str.c_str(), str.size());
+        }
         #endif
         break;
     case DBItem::lwvt_binary:
@@ -162,11 +161,8 @@ std::tistream& linguversa::operator>>(std::tistream& ar, DBItem& var)
     {
         size_t baSize = 0;
         ar >> baSize;
-        if (var.m_pByteArray == nullptr || var.m_nVarType != vt)
-            var.m_pByteArray = new bytearray();
-        bytearray& ba = *var.m_pByteArray;
-        ba.resize(baSize);
-        for (size_t i = 0; i < ba.size(); i++)
+        unsigned char* ba = var.ResizeData(DBItem::lwvt_bytearray, baSize);
+        for (size_t i = 0; i < baSize; i++)
         {
 #ifdef UNICODE
             int ival = 0;
@@ -179,9 +175,7 @@ std::tistream& linguversa::operator>>(std::tistream& ar, DBItem& var)
     }
     break;
     case DBItem::lwvt_uint64:
-        if (var.m_pUInt64 == nullptr || var.m_nVarType != vt)
-            var.m_pUInt64 = new UINT64();
-        ar >> (*var.m_pUInt64);
+        ar >> var.m_ui64Val;
         break;
     default:
         assert(false);
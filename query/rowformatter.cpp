@@ -0,0 +1,81 @@
+#include "rowformatter.h"
+
+using namespace std;
+using namespace linguversa;
+
+RowFormatter::RowFormatter( const ResultInfo& resultinfo, const tstring& fmt)
+{
+    Compile(resultinfo, fmt);
+}
+
+void RowFormatter::Compile( const ResultInfo& resultinfo, const tstring& fmt)
+{
+    m_Tokens.clear();
+
+    // The same parsing as in DataRow::Format(): a pair of [] is a column slot if its content
+    // up to an optional ':' is the name of a column, the rest up to ']' is the column format.
+    size_t nLiteral = 0;    // start of the pending literal text
+    size_t pos0 = fmt.find(_T('['));
+    while (pos0 != tstring::npos)
+    {
+        size_t pos1 = fmt.find(_T(':'), pos0);
+        size_t pos2 = fmt.find(_T(']'), pos0);
+        if (pos2 == tstring::npos)
+            break; // we are done, nothing more to replace
+
+        tstring colname;
+        tstring colfmt;
+        if (pos1 != tstring::npos && pos1 < pos2)
+        {
+            // ':' and format found
+            colname = fmt.substr(pos0 + 1, pos1 - pos0 - 1);
+            colfmt = fmt.substr(pos1 + 1, pos2 - pos1 - 1);
+        }
+        else
+        {
+            // no format found
+            colname = fmt.substr(pos0 + 1, pos2 - pos0 - 1);
+        }
+
+        int col = -1;
+        if (colname.length() > 0 && (col = resultinfo.GetSqlColumn(colname)) >= 0)
+        {
+            Token token{ fmt.substr(nLiteral, pos0 - nLiteral), col, ColumnFormatter(colfmt) };
+            m_Tokens.push_back(std::move(token));
+            nLiteral = pos2 + 1;
+            pos0 = fmt.find(_T('['), nLiteral);
+        }
+        else
+        {
+            // search for the next occurence of [
+            pos0 = fmt.find(_T('['), pos0 + 1);
+        }
+    }
+
+    if (nLiteral < fmt.length())
+    {
+        Token token{ fmt.substr(nLiteral), -1, ColumnFormatter() };
+        m_Tokens.push_back(std::move(token));
+    }
+}
+
+void RowFormatter::Format( const DataRow& row, tstring& text) const
+{
+    tstring sValue;
+    for (const Token& token : m_Tokens)
+    {
+        text += token.m_Literal;
+        if (token.m_nColumn >= 0)
+        {
+            token.m_Formatter.Format(row.at(token.m_nColumn), sValue);
+            text += sValue;
+        }
+    }
+}
+
+tstring RowFormatter::Format( const DataRow& row) const
+{
+    tstring text;
+    Format(row, text);
+    return text;
+}
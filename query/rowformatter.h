@@ -0,0 +1,38 @@
+#pragma once
+
+#include "tstring.h"
+#include "datarow.h"
+#include "resultinfo.h"
+#include "columnformatter.h"
+#include <vector>
+
+namespace linguversa
+{
+    // A row format such as _T("[name:%s] [price:%.2f|n/a]\n"), compiled once against the columns of a
+    // result set into a list of literal texts and column slots with a ColumnFormatter each.
+    // Format() then appends a row to the output without searching or replacing in the format string.
+    // The output is the same as of DataRow::Format(): brackets which do not contain a column name are
+    // copied literally, and the text inserted for a column is not searched for brackets again.
+    class RowFormatter
+    {
+    public:
+        RowFormatter() {};
+        RowFormatter( const ResultInfo& resultinfo, const std::tstring& fmt);
+
+        void Compile( const ResultInfo& resultinfo, const std::tstring& fmt);
+        bool IsEmpty() const { return m_Tokens.empty(); };
+
+        // Append the formatted row to text. A compiled formatter can be used by several threads at once.
+        void Format( const DataRow& row, std::tstring& text) const;
+        std::tstring Format( const DataRow& row) const;
+
+    protected:
+        struct Token
+        {
+            std::tstring m_Literal;     // text before the column
+            int m_nColumn;              // -1 for the literal text at the end
+            ColumnFormatter m_Formatter;
+        };
+        std::vector<Token> m_Tokens;
+    };
+}
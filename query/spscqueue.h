@@ -0,0 +1,91 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+namespace linguversa
+{
+// Bounded ring buffer for exactly one producer and one consumer thread.
+// TryPush() and TryPop() never block and take no lock, Push() and Pop() wait while the queue
+// is full resp. empty, which gives the producer backpressure from a slow consumer.
+// Close() - called by either side - ends the stream: Push() fails from then on,
+// Pop() still returns the remaining elements and fails when the queue is empty.
+template <class T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue( size_t nCapacity)
+        : m_Slots(nCapacity + 1), m_nHead(0), m_nTail(0), m_bClosed(false) {};
+    SpscQueue( const SpscQueue&) = delete;
+    SpscQueue& operator = ( const SpscQueue&) = delete;
+
+    // value is moved into the queue only if there is room
+    bool TryPush( T&& value)
+    {
+        size_t nTail = m_nTail.load(std::memory_order_relaxed);
+        size_t nNext = Next(nTail);
+        if (nNext == m_nHead.load(std::memory_order_acquire))
+            return false;
+        m_Slots[nTail] = std::move(value);
+        m_nTail.store(nNext, std::memory_order_release);
+        return true;
+    };
+
+    bool TryPop( T& value)
+    {
+        size_t nHead = m_nHead.load(std::memory_order_relaxed);
+        if (nHead == m_nTail.load(std::memory_order_acquire))
+            return false;
+        value = std::move(m_Slots[nHead]);
+        m_nHead.store(Next(nHead), std::memory_order_release);
+        return true;
+    };
+
+    bool Push( T&& value)
+    {
+        for (unsigned int n = 0; !IsClosed(); n++)
+        {
+            if (TryPush(std::move(value)))
+                return true;
+            Backoff(n);
+        }
+        return false;
+    };
+
+    bool Pop( T& value)
+    {
+        for (unsigned int n = 0; ; n++)
+        {
+            if (TryPop(value))
+                return true;
+            if (IsClosed())
+                return TryPop(value);
+            Backoff(n);
+        }
+    };
+
+    void Close() { m_bClosed.store(true, std::memory_order_release); };
+    bool IsClosed() const { return m_bClosed.load(std::memory_order_acquire); };
+    size_t GetCapacity() const { return m_Slots.size() - 1; };
+
+protected:
+    size_t Next( size_t n) const { return (n + 1 == m_Slots.size()) ? 0 : n + 1; };
+
+    // yield first, then sleep, so that a stalled stage does not burn a core
+    static void Backoff( unsigned int n)
+    {
+        if (n < 64)
+            std::this_thread::yield();
+        else
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+    };
+
+    std::vector<T> m_Slots;     // one slot stays empty to tell a full from an empty queue
+    alignas(64) std::atomic<size_t> m_nHead;    // next slot to pop, written by the consumer only
+    alignas(64) std::atomic<size_t> m_nTail;    // next slot to push, written by the producer only
+    std::atomic<bool> m_bClosed;
+};
+
+}
@@ -2,3 +2,36 @@
 #include <sqlext.h>
 #include <vector>
 #include <map>
+#include <cstring>
+#include <unordered_map>
+#include <cstddef>
+#include <new>
+#if ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L) && defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#endif
+#endif
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include <thread>
+#include <deque>
+#include <list>
+#include <memory>
+#include <functional>
+#include <ostream>
+#include <istream>
+#include <future>
+#include <exception>
+#include <cmath>
+#if ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L) && defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#endif
+#endif
@@ -1,8 +1,15 @@
 #include "target.h"
 #include "query.h"
 #include "lvstring.h"
+#include "spscqueue.h"
+#include "threadpool.h"
 #include <sstream>
 #include <cassert>
+#include <thread>
+#include <chrono>
+#include <future>
+#include <deque>
+#include <memory>
 
 #ifdef _WIN32
 // various Window platforms:
@@ -46,6 +53,9 @@ bool Target::OpenConnection(std::tstring connection)
 {
 	Close();
 	bool ret = m_connnection.Open(connection);
+	// Apply() executes each statement with a new Query, which then reuses the same handle
+	if (ret)
+		m_connnection.SetStatementPoolSize(2);
 	selector = ret ? sel_odbc : sel_stdout;
 	return ret;
 }
@@ -412,6 +422,69 @@ TargetStream::TargetStream( Connection& con)
     : std::tostream(_strstream.rdbuf())
 {
     _pCon = &con;
+    InitData();
+    UseStatementPool();
+}
+
+void TargetStream::InitData()
+{
+    _nBatchSize = 1000;
+    _nCommitRows = 0;
+    _nCommitBytes = 0;
+    _nPendingRows = 0;
+    _nPendingBytes = 0;
+    _nPipelineDepth = 0;
+    _nPipelineRows = 256;
+    _nFormatThreads = 1;
+}
+
+void TargetStream::SetPipeline( size_t nQueueDepth, size_t nBatchRows, size_t nFormatThreads)
+{
+    _nPipelineDepth = nQueueDepth;
+    _nPipelineRows = (nBatchRows > 0) ? nBatchRows : 1;
+    _nFormatThreads = (nFormatThreads > 0) ? nFormatThreads : 1;
+}
+
+void TargetStream::SetCommitEvery( size_t nRows, size_t nBytes)
+{
+    _nCommitRows = nRows;
+    _nCommitBytes = nBytes;
+}
+
+SQLRETURN TargetStream::Commit()
+{
+    _nPendingRows = 0;
+    _nPendingBytes = 0;
+    if (_pCon == nullptr || !_pCon->IsInTransaction())
+        return SQL_SUCCESS;
+    return _pCon->Commit();
+}
+
+SQLRETURN TargetStream::Rollback()
+{
+    _nPendingRows = 0;
+    _nPendingBytes = 0;
+    if (_pCon == nullptr || !_pCon->IsInTransaction())
+        return SQL_SUCCESS;
+    return _pCon->Rollback();
+}
+
+void TargetStream::BeginWrite()
+{
+    if ((_nCommitRows > 0 || _nCommitBytes > 0) && _pCon != nullptr && !_pCon->IsInTransaction())
+        _pCon->BeginTransaction();
+}
+
+void TargetStream::EndWrite( size_t nRows, size_t nBytes)
+{
+    if (_nCommitRows == 0 && _nCommitBytes == 0)
+        return;
+
+    _nPendingRows += nRows;
+    _nPendingBytes += nBytes;
+    if ((_nCommitRows > 0 && _nPendingRows >= _nCommitRows)
+        || (_nCommitBytes > 0 && _nPendingBytes >= _nCommitBytes))
+        Commit();
 }
 
 void TargetStream::SetConnection( Connection& con)
@@ -420,17 +493,25 @@ void TargetStream::SetConnection( Connection& con)
         _strstream.str(std::tstring());
     this->rdbuf(_strstream.rdbuf());
     _pCon = &con;
+    UseStatementPool();
 }
 
-void TargetStream::OutputAsCSV( Query& query, const tstring fieldseparator,
-    const tstring decimalformat, const tstring datetimeformat)
+void TargetStream::UseStatementPool()
+{
+    // Apply() executes each flush with a new Query, which then reuses the same handle
+    if (_pCon != nullptr && _pCon->GetStatementPoolSize() < 2)
+        _pCon->SetStatementPoolSize(2);
+}
+
+size_t TargetStream::OutputAsCSV( Query& query, const tstring fieldseparator,
+    const tstring decimalformat, const tstring datetimeformat, bool bHeader)
 {
     if (IsODBC())
-        return; // better: even throw an error
+        return 0; // better: even throw an error
 
     short colcount = query.GetODBCFieldCount();
     if (colcount <= 0)
-        return;
+        return 0;
 
     tostream& os = (*this);
 
@@ -438,7 +519,7 @@ void TargetStream::OutputAsCSV( Query& query, const tstring fieldseparator,
     // Retrieve meta information on the columns of the result set
     // this is NOT mandatory for the subsequent retrieval of the column values
     // ***********************************************************************
-    for (short col = 0; col < colcount; col++)
+    for (short col = 0; bHeader && col < colcount; col++)
     {
         FieldInfo fieldinfo;
         query.GetODBCFieldInfo(col, fieldinfo);
@@ -449,61 +530,249 @@ void TargetStream::OutputAsCSV( Query& query, const tstring fieldseparator,
             os << fieldseparator;
     }
 
-    // ***********************************************************************
-    // Now we retrieve data by iterating over the rows of the result set.
-    // If Result set has 0 rows it will skip the loop because nRetCode is set to SQL_NO_DATA immediately
-    // ***********************************************************************
-    for (SQLRETURN nRetCode = query.Fetch(); nRetCode != SQL_NO_DATA; nRetCode = query.Fetch())
+    // The same formatting is used by the serial and by the pipelined output. It works on copies of
+    // the field infos and column formats, which the fetching thread does not touch.
+    vector<FieldInfo> fieldinfos(colcount);
+    for (short col = 0; col < colcount; col++)
+        query.GetODBCFieldInfo(col, fieldinfos[col]);
+    const vector<Query::ColumnFormat> columnformats = query.GetColumnFormats();
+    assert(columnformats.size() == (size_t) colcount);
+
+    auto formatRow = [&](const DataRow& row, tstring& text)
     {
         for (short col = 0; col < colcount; col++)
         {
-            DBItem varValue;
-            query.GetFieldValue(col, varValue);
-            FieldInfo fieldinfo;
-            query.GetODBCFieldInfo(col, fieldinfo);
-            if ((fieldinfo.GetDefaultCType() == SQL_C_FLOAT 
-                || fieldinfo.GetDefaultCType() == SQL_C_DOUBLE) && !decimalformat.empty())
-            {
-                DBItem varValue;
-                query.GetFieldValue(col, varValue);
-                os << DBItem::ConvertToString(varValue, decimalformat);
-            }
-            else if (fieldinfo.GetDefaultCType() == SQL_C_TIMESTAMP 
-                && !datetimeformat.empty())
-            {
-                DBItem varValue;
-                query.GetFieldValue(col, varValue);
-                os << DBItem::ConvertToString(varValue, datetimeformat);
-            }
+            const short nCType = fieldinfos[col].GetDefaultCType();
+            if ((nCType == SQL_C_FLOAT || nCType == SQL_C_DOUBLE) && !decimalformat.empty())
+                text += DBItem::ConvertToString(row[col], decimalformat);
+            else if (nCType == SQL_C_TIMESTAMP && !datetimeformat.empty())
+                text += DBItem::ConvertToString(row[col], datetimeformat);
             else
-            {
-                os << query.FormatFieldValue(col);
-            }
+                text += Query::FormatColumnValue(columnformats[col], row[col]);
 
             if (col == colcount - 1)
-                os << endl;
+                text += _T('\n');
             else
-                os << fieldseparator;
+                text += fieldseparator;
         }
+    };
+
+    if (_nPipelineDepth > 0)
+        return OutputPipelined(query, formatRow);
+
+    // ***********************************************************************
+    // Now we retrieve data by iterating over the rows of the result set.
+    // If Result set has 0 rows it will skip the loop because nRetCode is set to SQL_NO_DATA immediately
+    // ***********************************************************************
+    size_t nRows = 0;
+    DataRow row;
+    tstring text;
+    for (SQLRETURN nRetCode = query.Fetch(); nRetCode != SQL_NO_DATA; nRetCode = query.Fetch())
+    {
+        query.GetCurrentRow(row);
+        text.clear();
+        formatRow(row, text);
+        os << text;
+        nRows++;
     }
+    os.flush();
+    return nRows;
 }
 
-void TargetStream::OutputFormatted( Query& query, tstring rowformat)
+size_t TargetStream::OutputFormatted( Query& query, tstring rowformat)
 {
     tostream& os = (*this);
 
+    // the format is parsed only once for the whole result set
+    RowFormatter formatter(query.GetResultInfo(), rowformat);
+    if (_nPipelineDepth > 0 && !IsODBC())
+        return OutputPipelined(query, [&](const DataRow& row, tstring& text) { formatter.Format(row, text); });
+
     // ***********************************************************************
     // Iterate over the rows of the current result set. 
     // If Result set has 0 rows it will skip the loop because nRetCode is set 
     // to SQL_NO_DATA immediately
     // ***********************************************************************
+    size_t nRows = 0;
+    tstring text;
     for (SQLRETURN nRetCode = query.Fetch(); nRetCode != SQL_NO_DATA; nRetCode = query.Fetch())
     {
         // apply user-defined rowformat to each row.
-        os << query.FormatCurrentRow(rowformat);
+        text.clear();
+        query.FormatCurrentRow(formatter, text);
+        os << text;
         if (IsODBC())
-            Apply();
+            Apply(1);
+        nRows++;
+    }
+    return nRows;
+}
+
+// Three stage pipeline: fetch (calling thread) -> format -> write. Each queue has a second queue
+// in the opposite direction, which returns the empty batches resp. text blocks for reuse, so that 
+// the buffers of the values and of the text are allocated only during the first batches.
+// With several format threads the format stage submits each batch to a ThreadPool and hands
+// the text blocks to the writer in the order of submission.
+size_t TargetStream::OutputPipelined( Query& query, const function<void(const DataRow&, tstring&)>& formatRow)
+{
+    typedef chrono::steady_clock clock;
+    struct RowBatch
+    {
+        vector<DataRow> rows;
+        size_t nRows = 0;
+    };
+
+    SpscQueue<RowBatch> fetched(_nPipelineDepth);
+    SpscQueue<RowBatch> fetchedFree(_nPipelineDepth + 2);
+    SpscQueue<tstring> formatted(_nPipelineDepth);
+    SpscQueue<tstring> formattedFree(_nPipelineDepth + 2);
+    PipelineStats stats;
+    exception_ptr formatError;
+    tostream& os = (*this);
+
+    thread formatter([&]()
+    {
+        struct FormatJob
+        {
+            RowBatch batch;
+            tstring text;
+            double dSeconds = 0.0;
+        };
+        typedef pair<future<void>, shared_ptr<FormatJob>> JobEntry;
+        unique_ptr<ThreadPool> pPool;
+        if (_nFormatThreads > 1)
+            pPool.reset(new ThreadPool(_nFormatThreads));
+        const size_t nMaxJobs = 2 * _nFormatThreads;
+        deque<JobEntry> jobs;
+
+        // waits for the oldest job and hands its text to the writer
+        auto completeJob = [&]()
+        {
+            clock::time_point t0 = clock::now();
+            // taken out first: get() invalidates the future, which must not be waited for again below
+            JobEntry entry = std::move(jobs.front());
+            jobs.pop_front();
+            entry.first.get();   // rethrows an exception of formatRow
+            FormatJob& job = *entry.second;
+            formatted.Push(std::move(job.text));
+            fetchedFree.TryPush(std::move(job.batch));
+            stats.dFormat += job.dSeconds;
+            stats.dFormatWait += chrono::duration<double>(clock::now() - t0).count();
+        };
+
+        RowBatch batch;
+        tstring text;
+        try
+        {
+            for (clock::time_point t0 = clock::now(); fetched.Pop(batch); t0 = clock::now())
+            {
+                clock::time_point t1 = clock::now();
+                stats.dFormatWait += chrono::duration<double>(t1 - t0).count();
+                if (!formattedFree.TryPop(text))
+                    text = tstring();
+                text.clear();
+                if (!pPool)
+                {
+                    for (size_t n = 0; n < batch.nRows; n++)
+                        formatRow(batch.rows[n], text);
+                    clock::time_point t2 = clock::now();
+                    formatted.Push(std::move(text));
+                    fetchedFree.TryPush(std::move(batch));
+                    stats.dFormat += chrono::duration<double>(t2 - t1).count();
+                    stats.dFormatWait += chrono::duration<double>(clock::now() - t2).count();
+                    continue;
+                }
+
+                shared_ptr<FormatJob> pJob = make_shared<FormatJob>();
+                pJob->batch = std::move(batch);
+                pJob->text = std::move(text);
+                auto pTask = make_shared<packaged_task<void()>>([pJob, &formatRow]()
+                {
+                    clock::time_point start = clock::now();
+                    for (size_t n = 0; n < pJob->batch.nRows; n++)
+                        formatRow(pJob->batch.rows[n], pJob->text);
+                    pJob->dSeconds = chrono::duration<double>(clock::now() - start).count();
+                });
+                jobs.emplace_back(pTask->get_future(), pJob);
+                pPool->Submit([pTask]() { (*pTask)(); });
+
+                // write the finished jobs in order, block only if too many batches are in flight
+                while (!jobs.empty() && (jobs.size() >= nMaxJobs 
+                    || jobs.front().first.wait_for(chrono::seconds(0)) == future_status::ready))
+                    completeJob();
+            }
+            while (!jobs.empty())
+                completeJob();
+        }
+        catch (...)
+        {
+            // stops the fetching
+            formatError = current_exception();
+            fetched.Close();
+            // the remaining tasks refer to formatRow
+            for (JobEntry& job : jobs)
+                if (job.first.valid())
+                    job.first.wait();
+        }
+        formatted.Close();
+    });
+
+    thread writer([&]()
+    {
+        tstring text;
+        for (clock::time_point t0 = clock::now(); formatted.Pop(text); t0 = clock::now())
+        {
+            clock::time_point t1 = clock::now();
+            os.write(text.data(), text.length());
+            formattedFree.TryPush(std::move(text));
+            stats.dWriteWait += chrono::duration<double>(t1 - t0).count();
+            stats.dWrite += chrono::duration<double>(clock::now() - t1).count();
+        }
+        os.flush();
+    });
+
+    try
+    {
+        clock::time_point start = clock::now();
+        RowBatch batch;
+        batch.rows.resize(_nPipelineRows);
+        for (SQLRETURN nRetCode = query.Fetch(); nRetCode != SQL_NO_DATA; nRetCode = query.Fetch())
+        {
+            query.GetCurrentRow(batch.rows[batch.nRows++]);
+            stats.nRows++;
+            if (batch.nRows < batch.rows.size())
+                continue;
+
+            clock::time_point t0 = clock::now();
+            bool bPushed = fetched.Push(std::move(batch));
+            stats.dFetchWait += chrono::duration<double>(clock::now() - t0).count();
+            stats.nBatches++;
+            if (!bPushed)
+                break;
+            if (!fetchedFree.TryPop(batch))
+                batch = RowBatch();
+            batch.rows.resize(_nPipelineRows);
+            batch.nRows = 0;
+        }
+        if (batch.nRows > 0 && fetched.Push(std::move(batch)))
+            stats.nBatches++;
+        stats.dFetch = chrono::duration<double>(clock::now() - start).count() - stats.dFetchWait;
     }
+    catch (...)
+    {
+        fetched.Close();
+        formatter.join();
+        writer.join();
+        throw;
+    }
+
+    fetched.Close();
+    formatter.join();
+    writer.join();
+    _PipelineStats = stats;
+    if (formatError)
+        rethrow_exception(formatError);
+    return stats.nRows;
 }
 
 void TargetStream::CreateTable(const Query& query, tstring tablename)
@@ -613,14 +882,19 @@ void TargetStream::CreateTable(const Query& query, tstring tablename)
     Apply();
 }
 
-void TargetStream::InsertAll(Query& query, tstring tablename)
+size_t TargetStream::InsertAll(Query& query, tstring tablename)
 {
     if (tablename.length() == 0)
-        return;
+        return 0;
 
     short colcount = query.GetODBCFieldCount();
     if (colcount <= 0)
-        return;
+        return 0;
+
+    if (IsODBC())
+        return InsertBatched(query, tablename);
+
+    size_t nRows = 0;
 
     tostream& os = (*this);
 
@@ -631,6 +905,7 @@ void TargetStream::InsertAll(Query& query, tstring tablename)
     bool bFirstRow = true;
     for (SQLRETURN nRetCode = query.Fetch(); nRetCode != SQL_NO_DATA; nRetCode = query.Fetch())
     {
+        nRows++;
         if (bFirstRow)
         {
             os << ::string_format(_T("insert into %01s( "), tablename.c_str());
@@ -699,18 +974,25 @@ void TargetStream::InsertAll(Query& query, tstring tablename)
     if (!bFirstRow)
     {
         os << _T(";");
-        Apply();
+        Apply(nRows);
     }
+
+    return nRows;
 }
 
-void TargetStream::InsertValues(Query& query, tstring tablename)
+size_t TargetStream::InsertValues(Query& query, tstring tablename)
 {
     if (tablename.length() == 0)
-        return;
+        return 0;
 
     short colcount = query.GetODBCFieldCount();
     if (colcount <= 0)
-        return;
+        return 0;
+
+    if (IsODBC())
+        return InsertBatched(query, tablename);
+
+    size_t nRows = 0;
 
     tostream& os = (*this);
 
@@ -721,6 +1003,7 @@ void TargetStream::InsertValues(Query& query, tstring tablename)
     bool bFirstRow = true;
     for (SQLRETURN nRetCode = query.Fetch(); nRetCode != SQL_NO_DATA; nRetCode = query.Fetch())
     {
+        nRows++;
         os << ::string_format(_T("insert into %01s( "), tablename.c_str());
         // ***********************************************************************
         // Retrieve meta information on the columns of the result set.
@@ -783,18 +1066,73 @@ void TargetStream::InsertValues(Query& query, tstring tablename)
     if (!bFirstRow)
     {
         os << _T(";");
-        Apply();
+        Apply(nRows);
+    }
+
+    return nRows;
+}
+
+size_t TargetStream::InsertBatched(Query& query, tstring tablename)
+{
+    short colcount = query.GetODBCFieldCount();
+
+    // one prepared statement for all rows instead of the values as SQL text,
+    // so memory is bounded by the batch size and nothing has to be parsed per row
+    tostringstream sql;
+    sql << ::string_format(_T("insert into %01s( "), tablename.c_str());
+    for (short col = 0; col < colcount; col++)
+    {
+        FieldInfo fieldinfo;
+        query.GetODBCFieldInfo(col, fieldinfo);
+        sql << fieldinfo.m_strName << (col < colcount - 1 ? _T(", ") : _T(")"));
     }
+    sql << _T(" values (");
+    for (short col = 0; col < colcount; col++)
+        sql << (col < colcount - 1 ? _T("?, ") : _T("?)"));
+
+    Query insert(_pCon);
+    insert.Prepare(sql.str());
+
+    // a transaction never ends within a batch
+    size_t nBatchSize = _nBatchSize;
+    if (_nCommitRows > 0 && _nCommitRows < nBatchSize)
+        nBatchSize = _nCommitRows;
+
+    size_t nRows = 0;
+    ColumnBatch batch;
+    while (query.FetchBatch(batch, nBatchSize) > 0)
+    {
+        BeginWrite();
+        // throws if any row of the batch has been rejected
+        insert.ExecuteBatch(batch);
+        nRows += batch.GetRowCount();
+
+        size_t nBytes = 0;
+        for (size_t col = 0; col < batch.GetColumnCount(); col++)
+        {
+            const ColumnVector& cv = batch[col];
+            nBytes += cv.m_Int32.size() * sizeof(SQLINTEGER) + cv.m_Int64.size() * sizeof(SQLBIGINT)
+                + cv.m_Double.size() * sizeof(double) + cv.m_Timestamp.size() * sizeof(TIMESTAMP_STRUCT)
+                + cv.m_Data.size();
+        }
+        EndWrite(batch.GetRowCount(), nBytes);
+    }
+
+    insert.Close();
+    return nRows;
 }
 
-SQLRETURN TargetStream::Apply()
+SQLRETURN TargetStream::Apply( size_t nRows)
 {
     SQLRETURN ret = SQL_SUCCESS;
     if (_pCon != nullptr && _pCon->IsOpen())
     {
-        Query query(_pCon);
-        ret = query.ExecDirect(_strstream.str());
+        tstring sql = _strstream.str();
         _strstream.str(std::tstring());
+        BeginWrite();
+        Query query(_pCon);
+        ret = query.ExecDirect(sql);
+        EndWrite(nRows, sql.length() * sizeof(TCHAR));
     }
     else
     {
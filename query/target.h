@@ -4,6 +4,7 @@
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <functional>
 #ifdef _WIN32
 #ifdef UNICODE
 #define tcout wcout
@@ -74,24 +75,82 @@ namespace linguversa
     {
     public:
         // default constructor
-        TargetStream() : std::tostream(nullptr) { _pCon = nullptr; };
-        TargetStream( std::tstreambuf* pbuf) : std::tostream(pbuf) { _pCon = nullptr; };
+        TargetStream() : std::tostream(nullptr) { _pCon = nullptr; InitData(); };
+        TargetStream( std::tstreambuf* pbuf) : std::tostream(pbuf) { _pCon = nullptr; InitData(); };
         TargetStream( linguversa::Connection& con);
 
         void SetConnection( linguversa::Connection& con);
 
-        void OutputAsCSV( linguversa::Query& query, const tstring fieldseparator, 
-            const tstring decimalformat = _T(""), const tstring datetimeformat = _T(""));
-        void OutputFormatted( linguversa::Query& query, tstring rowformat);
+        // bHeader = false omits the line with the column names, e.g. for all but the first part of a result set.
+        // Both return the number of rows.
+        size_t OutputAsCSV( linguversa::Query& query, const tstring fieldseparator, 
+            const tstring decimalformat = _T(""), const tstring datetimeformat = _T(""), bool bHeader = true);
+        size_t OutputFormatted( linguversa::Query& query, tstring rowformat);
         void CreateTable( const linguversa::Query& query, tstring tablename);
-        void InsertAll( linguversa::Query& query, tstring tablename);
-        void InsertValues(linguversa::Query& query, tstring tablename);
+        // For an ODBC target both functions execute a prepared insert statement with parameter arrays
+        // of up to GetBatchSize() rows, otherwise they write the insert statements as SQL text.
+        // Both return the number of rows.
+        size_t InsertAll( linguversa::Query& query, tstring tablename);
+        size_t InsertValues(linguversa::Query& query, tstring tablename);
+
+        void SetBatchSize( size_t nBatchSize) { _nBatchSize = (nBatchSize > 0) ? nBatchSize : 1; };
+        size_t GetBatchSize() const { return _nBatchSize; };
+
+        // For an ODBC target: instead of autocommitting each statement, group the inserted rows into
+        // transactions of nRows rows or nBytes bytes, whichever is reached first (0 = no limit).
+        // Commit() must be called at the end for the remaining rows.
+        void SetCommitEvery( size_t nRows, size_t nBytes = 0);
+        SQLRETURN Commit();
+        SQLRETURN Rollback();
 
         bool IsODBC() { return (_pCon != nullptr); };
-        SQLRETURN Apply();
+        // Execute the text written so far on the ODBC target. nRows is the number of data rows
+        // it contains, which counts for SetCommitEvery(); 0 for DDL and other scripts.
+        SQLRETURN Apply( size_t nRows = 0);
+
+        // Pipelined output to a text target: OutputAsCSV() and OutputFormatted() fetch on the calling thread,
+        // format on a second and write on a third thread. The stages hand over batches of nBatchRows rows
+        // through queues of at most nQueueDepth batches, so a slow writer throttles the fetching.
+        // nQueueDepth = 0 (the default) means serial output. The output is the same in both modes.
+        // With nFormatThreads > 1 the batches are formatted concurrently on a ThreadPool and
+        // written in their original order.
+        void SetPipeline( size_t nQueueDepth, size_t nBatchRows = 256, size_t nFormatThreads = 1);
+
+        // Busy and waiting times in seconds of the stages of the last pipelined output.
+        struct PipelineStats
+        {
+            size_t nRows = 0;
+            size_t nBatches = 0;
+            double dFetch = 0.0;
+            double dFetchWait = 0.0;    // waiting for room in the queue to the formatter
+            double dFormat = 0.0;       // summed over all format threads
+            double dFormatWait = 0.0;   // waiting for rows or for room in the queue to the writer
+            double dWrite = 0.0;
+            double dWriteWait = 0.0;    // waiting for formatted text
+        };
+        const PipelineStats& GetPipelineStats() const { return _PipelineStats; };
 
     private:
         tstringstream _strstream;
         Connection* _pCon;
+        size_t _nBatchSize;
+        size_t _nCommitRows;
+        size_t _nCommitBytes;
+        size_t _nPendingRows;   // written since the last commit
+        size_t _nPendingBytes;
+        size_t _nPipelineDepth;
+        size_t _nPipelineRows;
+        size_t _nFormatThreads;
+        PipelineStats _PipelineStats;
+
+        void InitData();
+        void UseStatementPool();
+        size_t OutputPipelined( linguversa::Query& query, 
+            const std::function<void(const linguversa::DataRow&, tstring&)>& formatRow);
+        size_t InsertBatched( linguversa::Query& query, tstring tablename);
+        // start a transaction before writing, if SetCommitEvery() is active
+        void BeginWrite();
+        // count written rows and commit if one of the limits is reached
+        void EndWrite( size_t nRows, size_t nBytes);
     };
 }
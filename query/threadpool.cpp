@@ -0,0 +1,89 @@
+#include "threadpool.h"
+
+using namespace linguversa;
+using namespace std;
+
+ThreadPool::ThreadPool(size_t nThreads)
+{
+    if (nThreads == 0)
+        nThreads = thread::hardware_concurrency();
+    if (nThreads == 0)
+        nThreads = 1;
+
+    m_nNext = 0;
+    m_nPending = 0;
+    m_bStop = false;
+    for (size_t n = 0; n < nThreads; n++)
+        m_Queues.emplace_back(new WorkQueue());
+    for (size_t n = 0; n < nThreads; n++)
+        m_Threads.emplace_back(&ThreadPool::Run, this, n);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> lock(m_WakeMutex);
+        m_bStop = true;
+    }
+    m_Wake.notify_all();
+    for (thread& worker : m_Threads)
+        worker.join();
+}
+
+void ThreadPool::Submit(function<void()> task)
+{
+    WorkQueue& queue = *m_Queues[m_nNext++ % m_Queues.size()];
+    {
+        // a worker between its check of m_nPending and the wait must not miss the notification.
+        // m_nPending is counted before the task can be taken, TryTake() must not decrement it below 0.
+        lock_guard<mutex> lock(m_WakeMutex);
+        m_nPending++;
+        lock_guard<mutex> queueLock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    m_Wake.notify_one();
+}
+
+bool ThreadPool::TryTake(size_t nWorker, function<void()>& task)
+{
+    // own queue first (front), then steal from the others (back)
+    for (size_t i = 0; i < m_Queues.size(); i++)
+    {
+        WorkQueue& queue = *m_Queues[(nWorker + i) % m_Queues.size()];
+        lock_guard<mutex> lock(queue.mutex);
+        if (queue.tasks.empty())
+            continue;
+        if (i == 0)
+        {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        else
+        {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        m_nPending--;
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::Run(size_t nWorker)
+{
+    function<void()> task;
+    for (;;)
+    {
+        if (TryTake(nWorker, task))
+        {
+            task();
+            task = nullptr;
+            continue;
+        }
+
+        unique_lock<mutex> lock(m_WakeMutex);
+        m_Wake.wait(lock, [this] { return m_bStop || m_nPending > 0; });
+        if (m_bStop && m_nPending == 0)
+            return;
+    }
+}
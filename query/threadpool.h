@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+namespace linguversa
+{
+    // A fixed number of worker threads executing tasks, e.g. the formatting of row batches.
+    // Each worker has its own queue; Submit() distributes the tasks round robin. A worker runs
+    // the tasks of its own queue in order and steals from the tail of the other queues when
+    // its own is empty, so that a worker which got long tasks does not hold up the others.
+    // The order of completion is not defined: wait for the results, e.g. with std::future.
+    class ThreadPool
+    {
+    public:
+        // nThreads = 0 means std::thread::hardware_concurrency()
+        explicit ThreadPool(size_t nThreads = 0);
+        // Executes the tasks still queued, then joins the workers.
+        ~ThreadPool();
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator = (const ThreadPool&) = delete;
+
+        void Submit(std::function<void()> task);
+        size_t GetThreadCount() const { return m_Threads.size(); };
+
+    protected:
+        struct WorkQueue
+        {
+            std::mutex mutex;
+            std::deque<std::function<void()>> tasks;
+        };
+
+        std::vector<std::unique_ptr<WorkQueue>> m_Queues;
+        std::vector<std::thread> m_Threads;
+        std::atomic<size_t> m_nNext;        // queue of the next submitted task
+        std::atomic<size_t> m_nPending;     // submitted, but not yet taken by a worker
+        std::mutex m_WakeMutex;
+        std::condition_variable m_Wake;
+        bool m_bStop;
+
+        void Run(size_t nWorker);
+        bool TryTake(size_t nWorker, std::function<void()>& task);
+    };
+}
@@ -0,0 +1,78 @@
+#include "watchdog.h"
+#include "query.h"
+
+using namespace linguversa;
+using namespace std;
+
+atomic<bool> Watchdog::s_bInterrupt(false);
+
+Watchdog& Watchdog::GetInstance()
+{
+    static Watchdog watchdog;
+    return watchdog;
+}
+
+Watchdog::Watchdog()
+{
+    m_bStop = false;
+}
+
+Watchdog::~Watchdog()
+{
+    {
+        lock_guard<mutex> lock(m_Mutex);
+        m_bStop = true;
+    }
+    m_Changed.notify_all();
+    if (m_Thread.joinable())
+        m_Thread.join();
+}
+
+void Watchdog::Watch(Query* pQuery, time_point deadline)
+{
+    {
+        lock_guard<mutex> lock(m_Mutex);
+        m_Deadlines[pQuery] = deadline;
+        if (!m_Thread.joinable())
+            m_Thread = thread(&Watchdog::Run, this);
+    }
+    m_Changed.notify_all();
+}
+
+void Watchdog::Unwatch(Query* pQuery)
+{
+    // Cancel() is called under the same lock
+    lock_guard<mutex> lock(m_Mutex);
+    m_Deadlines.erase(pQuery);
+}
+
+void Watchdog::Interrupt()
+{
+    s_bInterrupt.store(true);
+}
+
+void Watchdog::Run()
+{
+    unique_lock<mutex> lock(m_Mutex);
+    while (!m_bStop)
+    {
+        time_point now = chrono::steady_clock::now();
+        time_point next = now + chrono::milliseconds(100);
+        bool bInterrupt = s_bInterrupt.load();
+        for (auto it = m_Deadlines.begin(); it != m_Deadlines.end(); )
+        {
+            if (bInterrupt || it->second <= now)
+            {
+                // cancelled once: an executing function fails, otherwise the next fetch does (IsCancelled());
+                // the query is watched again with the next SetDeadline()
+                it->first->Cancel();
+                it = m_Deadlines.erase(it);
+                continue;
+            }
+            if (it->second < next)
+                next = it->second;
+            ++it;
+        }
+        m_Changed.wait_until(lock, next);
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <map>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace linguversa
+{
+    class Query;
+
+    // A thread which cancels the statements of queries whose deadline has passed, see Query::SetDeadline().
+    // SQLCancel is the one ODBC function which may be called for a statement executing on another thread;
+    // the cancelled function then fails with SQLSTATE HY008.
+    class Watchdog
+    {
+    public:
+        typedef std::chrono::steady_clock::time_point time_point;
+
+        // the process wide watchdog, its thread starts with the first Watch()
+        static Watchdog& GetInstance();
+        ~Watchdog();
+        Watchdog(const Watchdog&) = delete;
+        Watchdog& operator = (const Watchdog&) = delete;
+
+        // Cancel pQuery at deadline unless Unwatch() is called before. time_point::max() means no deadline,
+        // but the query is still cancelled by Interrupt().
+        void Watch(Query* pQuery, time_point deadline);
+        // After Unwatch() returns, the watchdog does not touch pQuery any more.
+        void Unwatch(Query* pQuery);
+
+        // Cancel all watched queries. Only sets an atomic flag which the watchdog thread checks
+        // every 100 ms, so it may be called from a signal handler (e.g. for SIGINT).
+        static void Interrupt();
+        static bool IsInterrupted() { return s_bInterrupt.load(); };
+        static void ResetInterrupt() { s_bInterrupt.store(false); };
+
+    protected:
+        Watchdog();
+        void Run();
+
+        std::mutex m_Mutex;
+        std::condition_variable m_Changed;
+        std::map<Query*, time_point> m_Deadlines;
+        bool m_bStop;
+        std::thread m_Thread;
+
+        static std::atomic<bool> s_bInterrupt;
+    };
+}
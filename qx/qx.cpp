@@ -14,6 +14,7 @@
 #include "../query/odbcenvironment.h"
 #include "../query/lvstring.h"
 #include "../query/target.h"
+#include "../query/watchdog.h"
 #ifndef UNICODE
 #ifdef _MSC_VER
 #pragma warning( push )
@@ -28,6 +29,20 @@
 #if ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L)
 #include <filesystem>
 #endif
+#include <chrono>
+#include <csignal>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#ifdef _WIN32
+#include <psapi.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "psapi.lib")
+#endif
+#else
+#include <sys/resource.h>
+#endif
 
 using namespace std;
 using namespace linguversa;
@@ -37,10 +52,38 @@ using namespace CLI;
 void ListDrivers();
 void ListDataSources(tstring drivername = _T(""));
 void OutputResultSet(tostream& os, Query& query, const tstring& fieldseparator);
+void OutputWithBlobFiles(tostream& os, Query& query, const tstring& fieldseparator, const tstring& blobdir);
 void BuildConnectionstring( tstring& sourcepath, tstring& connectionstring, tstring& stmt);
 void ConfigToSchema(tstring filepath, tstring configname);
 string validateSqliteFilename( string& path);
 void ParseColumnSpec(vector<tstring>& columns, ResultInfo& resultinfo);
+size_t GetPeakRSS();
+void ReportThroughput(size_t nRows, chrono::steady_clock::time_point start);
+void ReportPipeline(const TargetStream::PipelineStats& stats);
+void OnInterrupt(int);
+void WatchQuery(Query& query, size_t timeout);
+
+// options of a select statement, which is extracted over several connections in parallel
+struct ParallelOptions
+{
+    size_t nPartitions = 1;
+    tstring partitionby;
+    bool bOrdered = false;
+    bool bVerbose = false;
+    tstring rowformat;
+    tstring insert;
+    tstring insertvalues;
+    tstring fieldseparator;
+    tstring decimalformat;
+    tstring datetimeformat;
+    tstring targetconnection;   // connection string of an odbc target, empty for a text target
+    size_t nBatchSize = 1000;
+    size_t nCommitRows = 0;
+    size_t nCommitBytes = 0;
+    size_t nTimeout = 0;
+};
+SQLRETURN ParallelExport(TargetStream& os, Query& query, const tstring& connectionstring, 
+    tstring sql, const ParallelOptions& options);
 
 // CSV helper functions
 #ifndef UNICODE
@@ -50,7 +93,7 @@ void OutputAsCSV(tostream& os, csv::CSVReader& reader, tstring fieldseparator);
 void OutputAsCSV(tostream& os, csv::CSVReader& reader, const ResultInfo& resultinfo, tstring fieldseparator);
 void OutputFormatted(TargetStream& os, csv::CSVReader& reader, const ResultInfo& resultinfo, 
     tstring rowformat, tstring csvdecimalsymbols = _T(""));
-tstring FormatCurrentRow(csv::CSVRow& csvrow, const ResultInfo& resultinfo, tstring rowformat, tstring csvdecimalsymbols = _T(""));
+tstring FormatCurrentRow(csv::CSVRow& csvrow, const ResultInfo& resultinfo, const RowFormatter& formatter, tstring csvdecimalsymbols = _T(""));
 void CreateTable(tostream& os, csv::CSVReader& reader, const ResultInfo& resultinfo, tstring tablename);
 // TODO:
 void CreateTable(tostream& os, const ResultInfo& resultinfo, tstring tablename);
@@ -84,6 +127,17 @@ int main(int argc, char** argv)
     tstring insert;
     tstring insertvalues;
     tstring createinsert;
+    size_t batchsize = 1000;
+    size_t commitevery = 0;
+    size_t commitbytes = 0;
+    size_t pipeline = 0;
+    size_t pipelinerows = 256;
+    size_t formatthreads = 1;
+    size_t timeout = 0;
+    size_t parallel = 1;
+    tstring partitionby;
+    bool ordered = false;
+    tstring blobdir;
     bool verbose = false;
     bool listdrivers = false;
     bool listdsn = false;
@@ -124,8 +178,28 @@ int main(int argc, char** argv)
     app.add_option("--create", create, "generate create statement for specified tablename")->excludes("--format")->excludes("--fieldseparator");
     app.add_option("--insert", insert, "generate one insert statement for specified tablename")->excludes("--format")->excludes("--fieldseparator");
     app.add_option("--insertvalues", insertvalues, "generate separate insert statements for specified tablename")->excludes("--format")->excludes("--fieldseparator")->excludes("--insert");
+    app.add_option("--batchsize", batchsize, "number of rows per insert with an odbc target (Default is 1000)");
+    app.add_option("--commitevery", commitevery, "commit every N rows with an odbc target (Default is autocommit)");
+    app.add_option("--commitbytes", commitbytes, "commit every N bytes with an odbc target (Default is autocommit)");
     app.add_option("--createinsert", createinsert, "generate create and insert statements for specified tablename")
         ->excludes("--format")->excludes("--fieldseparator")->excludes("--create")->excludes("--insert")->excludes("--insertvalues");
+    app.add_option("--timeout", timeout, "cancel a statement after N seconds (Default is 0: no timeout)");
+    app.add_option("--pipeline", pipeline, "fetch, format and write on separate threads with queues of N batches (Default is 0: serial)");
+    app.add_option("--pipelinerows", pipelinerows, "number of rows per batch of --pipeline (Default is 256)")
+        ->needs("--pipeline");
+    app.add_option("--formatthreads", formatthreads, "number of threads formatting the batches of --pipeline (Default is 1)")
+        ->needs("--pipeline");
+    app.add_option("--parallel", parallel, "number of connections which extract a select statement in parallel (Default is 1)")
+        ->excludes("--create")->excludes("--createinsert");
+    app.add_option("--partition-by", partitionby, "integer column of the select statement to split into disjoint ranges, "
+        "e.g. rowid on SQLite if selected as \"select rowid as id, * from ...\"")
+        ->needs("--parallel");
+    app.add_flag("--ordered", ordered, "output the partitions of --parallel in the order of their ranges")
+        ->needs("--parallel");
+    app.add_option("--blobdir", blobdir, "write binary and long text columns into separate files in this directory "
+        "and output their paths instead of the values")
+        ->excludes("--format")->excludes("--create")->excludes("--insert")->excludes("--insertvalues")
+        ->excludes("--createinsert")->excludes("--parallel");
     app.add_option("--input", input, "filepath of input file containing SQL statements")
         ->check(CLI::ExistingFile | CLI::Validator([](string& s) { return s == "stdin" ? "" : "stdin"; }, "stdin"));;
     app.add_option("--outputfile", outputfile, "filepath of output file");
@@ -145,6 +219,12 @@ int main(int argc, char** argv)
         insert = createinsert;
     }
 
+    if (parallel > 1 && partitionby.length() == 0)
+    {
+        tcerr << _T("Error: --parallel requires --partition-by!") << endl;
+        return -1;
+    }
+
     tofstream ofs;
     Connection target;
     TargetStream os;
@@ -165,12 +245,18 @@ int main(int argc, char** argv)
         {
             ret = target.Open(targetspec.substr(5));
             if (ret == true)
+            {
                 os.SetConnection(target);
+                os.SetBatchSize(batchsize);
+                os.SetCommitEvery(commitevery, commitbytes);
+            }
         }
         else if (targetspec == _T("stdout"))
         {
             os.rdbuf(tcout.rdbuf());
         }
+        if (!os.IsODBC())
+            os.SetPipeline(pipeline, pipelinerows, formatthreads);
 
         if (ret == false)
         {
@@ -181,6 +267,7 @@ int main(int argc, char** argv)
     else
     {
         os.rdbuf(tcout.rdbuf());
+        os.SetPipeline(pipeline, pipelinerows, formatthreads);
     }
 
     SQLRETURN nRetCode = SQL_SUCCESS;
@@ -374,7 +461,15 @@ int main(int argc, char** argv)
     {
         b = con.Open( connectionstring);
         if (b)
+        {
             query.SetDatabase(con);
+#ifdef USE_ROWDATA
+            // long values of each row come from an arena which is recycled by every Fetch()
+            query.UseArena();
+#endif
+            if (timeout > 0)
+                query.SetQueryTimeout(timeout);
+        }
     } 
     catch(DbException& ex)
     {
@@ -411,6 +506,9 @@ int main(int argc, char** argv)
         return -1;
     }
 
+    // Ctrl-C cancels the running statements, see WatchQuery()
+    signal(SIGINT, OnInterrupt);
+
     // ready to execute real sql statements (from command line parameters)
     for (size_t n = 0; n < sqlcmd.size(); n++)
     {
@@ -420,6 +518,31 @@ int main(int argc, char** argv)
 
         try
         {
+            WatchQuery(query, timeout);
+            if (parallel > 1)
+            {
+                ParallelOptions options;
+                options.nPartitions = parallel;
+                options.partitionby = partitionby;
+                options.bOrdered = ordered;
+                options.bVerbose = verbose;
+                options.rowformat = rowformat;
+                options.insert = insert;
+                options.insertvalues = insertvalues;
+                options.fieldseparator = fieldseparator;
+                options.decimalformat = decimalformat;
+                options.datetimeformat = datetimeformat;
+                if (os.IsODBC())
+                    options.targetconnection = targetspec.substr(5);
+                options.nBatchSize = batchsize;
+                options.nCommitRows = commitevery;
+                options.nCommitBytes = commitbytes;
+                options.nTimeout = timeout;
+                nRetCode = ParallelExport(os, query, connectionstring, sql, options);
+                query.ClearDeadline();
+                continue;
+            }
+
             nRetCode = query.ExecDirect(sql);
 
             if (SQL_SUCCEEDED(nRetCode) && create.length() > 0)
@@ -439,6 +562,8 @@ int main(int argc, char** argv)
                     // to SQL_NO_DATA immediately
                     // ***********************************************************************
                     os.OutputFormatted(query, rowformat);
+                    if (verbose && pipeline > 0)
+                        ReportPipeline(os.GetPipelineStats());
                 }
                 else if (insert.length() > 0)
                 {
@@ -446,7 +571,10 @@ int main(int argc, char** argv)
                         query.SetCTypeFormat(SQL_C_TIMESTAMP, datetimeformat);
                     // Iterate over all rows of the curnnt result set and
                     // create one insert statement for all rows.
-                    os.InsertAll(query, insert);
+                    auto start = chrono::steady_clock::now();
+                    size_t nRows = os.InsertAll(query, insert);
+                    if (verbose)
+                        ReportThroughput(nRows, start);
                 }
                 else if (insertvalues.length() > 0)
                 {
@@ -454,17 +582,28 @@ int main(int argc, char** argv)
                         query.SetCTypeFormat(SQL_C_TIMESTAMP, datetimeformat);
                     // Iterate over all rows of the curnnt result set and
                     // create a separate insert statement for each row.
-                    os.InsertValues(query, insertvalues);
+                    auto start = chrono::steady_clock::now();
+                    size_t nRows = os.InsertValues(query, insertvalues);
+                    if (verbose)
+                        ReportThroughput(nRows, start);
+                }
+                else if (blobdir.length() > 0)
+                {
+                    // Stream the large columns into files, the rest as in the standard format.
+                    OutputWithBlobFiles(os, query, fieldseparator, blobdir);
                 }
                 else if (create.length() == 0) // the default only applies if no output format is not given
                 {
                     // Output the complete current result set in standard format.
                     os.OutputAsCSV(query, fieldseparator, decimalformat, datetimeformat);
+                    if (verbose && pipeline > 0)
+                        ReportPipeline(os.GetPipelineStats());
                 }
 
                 // there may be more result sets ...
                 nRetCode = query.SQLMoreResults();
             }
+            query.ClearDeadline();
         }
         catch (DbException& ex)
         {
@@ -514,6 +653,9 @@ int main(int argc, char** argv)
                         // do something with sql ...
                         try
                         {
+                            // Ctrl-C at the prompt does not cancel this statement
+                            Watchdog::ResetInterrupt();
+                            WatchQuery(query, timeout);
                             nRetCode = query.ExecDirect(sql.str());
 
                             // Even a single statement (or.batch of statements) can have more than one result set.
@@ -521,7 +663,10 @@ int main(int argc, char** argv)
                             while (SQL_SUCCEEDED(nRetCode))
                             {
                                 // Output the complete current result set in standard format.
-                                ::OutputResultSet(os, query, fieldseparator);
+                                if (blobdir.length() > 0)
+                                    OutputWithBlobFiles(os, query, fieldseparator, blobdir);
+                                else
+                                    ::OutputResultSet(os, query, fieldseparator);
 
                                 // there may be more result sets ...
                                 nRetCode = query.SQLMoreResults();
@@ -533,6 +678,9 @@ int main(int argc, char** argv)
                             tcerr << _T("Execute error:") << endl;
                             cerr << ex.what() << endl;
                         }
+                        query.ClearDeadline();
+                        // a cancelled statement does not end the interactive mode
+                        signal(SIGINT, OnInterrupt);
 
                         // and afterwards reset the sql to empty string
                         sql.str(std::tstring());
@@ -570,6 +718,18 @@ int main(int argc, char** argv)
             ifs.close();
     }
 
+    try
+    {
+        // the rows after the last --commitevery / --commitbytes limit
+        os.Commit();
+    }
+    catch (DbException& ex)
+    {
+        nRetCode = ex.getSqlCode();
+        tcerr << _T("Commit error:") << endl;
+        cerr << ex.what() << endl;
+    }
+
     os.flush();
     os.rdbuf(tcout.rdbuf());
     if (ofs.is_open())
@@ -640,6 +800,104 @@ void OutputResultSet(tostream& os, Query& query, const tstring& fieldseparator)
     }
 }
 
+// Like OutputResultSet(), but binary and long text columns are streamed with Query::StreamFieldValue()
+// into one file per value, named <column>_<result set>_<row>.bin resp. .txt, and only the file path is output.
+// The result sets are numbered across all calls, so a later result set never overwrites the files of an
+// earlier one. Wide character columns are written in UTF-16, the others as they come from the driver.
+// So even huge values are never held in memory as a whole. The file of a null value is removed.
+// Characters of the column name which are not allowed in file names are replaced by '_'.
+// A file which cannot be written is reported on stderr and its value is left empty.
+// Before C++17 the directory must already exist.
+void OutputWithBlobFiles(tostream& os, Query& query, const tstring& fieldseparator, const tstring& blobdir)
+{
+    short colcount = query.GetODBCFieldCount();
+    if (colcount <= 0)
+        return;
+
+#if ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L)
+    std::filesystem::create_directories(std::filesystem::path(blobdir));
+#endif
+
+    vector<FieldInfo> fieldinfos(colcount);
+    vector<tstring> filenames(colcount);
+    for (short col = 0; col < colcount; col++)
+    {
+        query.GetODBCFieldInfo(col, fieldinfos[col]);
+        os << fieldinfos[col].m_strName;
+        if (col == colcount - 1)
+            os << endl;
+        else
+            os << fieldseparator;
+
+        // the column name must not lead out of the directory or be invalid as file name
+        filenames[col] = fieldinfos[col].m_strName;
+        for (TCHAR& c : filenames[col])
+        {
+            if ((unsigned) c < 0x20 || tstring(_T("/\\:*?\"<>|")).find(c) != tstring::npos)
+                c = _T('_');
+        }
+        if (filenames[col].empty())
+            filenames[col] = ::string_format(_T("column%d"), col + 1);
+    }
+
+    static std::atomic<size_t> nResultSets(0);
+    size_t nResultSet = ++nResultSets;
+    size_t nRow = 0;
+    for (SQLRETURN nRetCode = query.Fetch(); nRetCode != SQL_NO_DATA; nRetCode = query.Fetch())
+    {
+        nRow++;
+        // SQLGetData() requires ascending column order with most drivers, so every column is read in turn
+        for (short col = 0; col < colcount; col++)
+        {
+            SQLSMALLINT nSQLType = fieldinfos[col].m_nSQLType;
+            bool bBinary = nSQLType == SQL_BINARY || nSQLType == SQL_VARBINARY || nSQLType == SQL_LONGVARBINARY;
+            bool bText = nSQLType == SQL_LONGVARCHAR || nSQLType == SQL_WLONGVARCHAR;
+            if (bBinary || bText)
+            {
+                tstringstream name;
+                name << blobdir << _T('/') << filenames[col] << _T('_') << nResultSet << _T('_') << nRow 
+                    << (bBinary ? _T(".bin") : _T(".txt"));
+                tstring filepath = name.str();
+                ofstream ofs(filepath, ios::out | ios::binary | ios::trunc);
+                if (!ofs.is_open())
+                {
+                    // the value is skipped, SQLGetData() continues with the next column
+                    tcerr << _T("Error: Cannot open ") << filepath << _T("!") << endl;
+                }
+                else
+                {
+                    SQLSMALLINT nCType = bBinary ? SQL_C_BINARY : (nSQLType == SQL_WLONGVARCHAR) ? SQL_C_WCHAR : SQL_C_CHAR;
+                    bool bNull = query.StreamFieldValue(col, ofs, nCType) == SQL_NULL_DATA;
+                    ofs.close();
+                    bool bFailed = !bNull && ofs.fail();
+                    if (bFailed)
+                        tcerr << _T("Error: Cannot write ") << filepath << _T("!") << endl;
+                    if (bNull || bFailed)
+                    {
+#if ((defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L)
+                        std::error_code ec;
+                        std::filesystem::remove(std::filesystem::path(filepath), ec);
+#elif defined(UNICODE)
+                        ::_wremove(filepath.c_str());
+#else
+                        ::remove(filepath.c_str());
+#endif
+                    }
+                    else
+                        os << filepath;
+                }
+            }
+            else
+                os << query.FormatFieldValue(col);
+
+            if (col == colcount - 1)
+                os << endl;
+            else
+                os << fieldseparator;
+        }
+    }
+}
+
 void ListDrivers()
 {
     tcout << _T("ODBCDrivers:") << endl;
@@ -1045,6 +1303,9 @@ void ParseColumnSpec(vector<tstring>& columns, ResultInfo& resultinfo)
             fi.m_nCType = SQL_C_TCHAR;
         }
     }
+
+    // DataRow::Format looks up the column names for each row
+    resultinfo.BuildIndex();
 }
 
 #ifndef UNICODE
@@ -1215,15 +1476,16 @@ void OutputAsCSV(tostream& os, csv::CSVReader& reader, tstring fieldseparator)
 
 void OutputFormatted(TargetStream& os, csv::CSVReader& reader, const ResultInfo& resultinfo, tstring rowformat, tstring csvdecimalsymbols)
 {
+    RowFormatter formatter(resultinfo, rowformat);
     for (csv::CSVRow& row : reader) // Input iterator
     {
-        os << FormatCurrentRow(row, resultinfo, rowformat, csvdecimalsymbols);
+        os << FormatCurrentRow(row, resultinfo, formatter, csvdecimalsymbols);
         if (os.IsODBC())
-            os.Apply();
+            os.Apply(1);
     }
 }
 
-tstring FormatCurrentRow(csv::CSVRow& csvrow, const ResultInfo& resultinfo, tstring rowformat, tstring csvdecimalsymbols)
+tstring FormatCurrentRow(csv::CSVRow& csvrow, const ResultInfo& resultinfo, const RowFormatter& formatter, tstring csvdecimalsymbols)
 {
     linguversa::DataRow dr;
     dr.resize(resultinfo.size());
@@ -1273,14 +1535,13 @@ tstring FormatCurrentRow(csv::CSVRow& csvrow, const ResultInfo& resultinfo, tstr
             val = field.get<string>();
             if (val.length() > 0)
             {
-                item.m_pstring = new tstring(val);
-                item.m_nVarType = DBItem::lwvt_string;
+                item.SetString(val);
             }
             break;
         }
     }
 
-    return dr.Format(resultinfo, rowformat);
+    return formatter.Format(dr);
 }
 
 void CreateTable(tostream& os, csv::CSVReader& reader, const ResultInfo& resultinfo, tstring tablename)
@@ -1399,3 +1660,374 @@ void InsertAll(tostream& os, csv::CSVReader& reader, const ResultInfo& resultinf
 }
 
 #endif
+
+// peak resident set size of the process in KB
+size_t GetPeakRSS()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (::GetProcessMemoryInfo(::GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return pmc.PeakWorkingSetSize / 1024;
+    return 0;
+#else
+    struct rusage usage;
+    if (::getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;  // bytes on macOS
+#else
+    return usage.ru_maxrss;         // KB on Linux
+#endif
+#endif
+}
+
+// written to stderr, because the output stream may be the target
+void ReportThroughput(size_t nRows, chrono::steady_clock::time_point start)
+{
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    tcerr << nRows << _T(" rows in ") << seconds << _T(" s");
+    if (seconds > 0)
+        tcerr << _T(" (") << (size_t) (nRows / seconds) << _T(" rows/s)");
+    tcerr << _T(", peak RSS ") << GetPeakRSS() << _T(" KB") << endl;
+}
+
+// The first Ctrl-C cancels the watched statements, a second one terminates qx as usual.
+void OnInterrupt(int)
+{
+    Watchdog::Interrupt();
+    signal(SIGINT, SIG_DFL);
+}
+
+// Let the watchdog cancel the statements of query after timeout seconds or on Ctrl-C.
+void WatchQuery(Query& query, size_t timeout)
+{
+    if (timeout > 0)
+        query.SetDeadline(chrono::steady_clock::now() + chrono::seconds(timeout));
+    else
+        query.SetDeadline(chrono::steady_clock::time_point::max());
+}
+
+// busy and waiting time of each stage of the pipelined output
+void ReportPipeline(const TargetStream::PipelineStats& stats)
+{
+    tcerr << stats.nRows << _T(" rows in ") << stats.nBatches << _T(" batches") << endl;
+    tcerr << _T("fetch:  ") << stats.dFetch << _T(" s, waiting ") << stats.dFetchWait << _T(" s") << endl;
+    tcerr << _T("format: ") << stats.dFormat << _T(" s, waiting ") << stats.dFormatWait << _T(" s") << endl;
+    tcerr << _T("write:  ") << stats.dWrite << _T(" s, waiting ") << stats.dWriteWait << _T(" s") << endl;
+}
+
+// *************************************************************************
+// Parallel partitioned extraction
+// *************************************************************************
+
+// Collects the output of the partitions, which is written by the worker threads in chunks,
+// and hands it to the thread writing to the real output stream. Each partition buffers 
+// at most nMaxChunks chunks, so a slow output blocks the workers instead of filling the memory.
+class ChunkMerger
+{
+public:
+    ChunkMerger(size_t nPartitions, bool bOrdered, size_t nMaxChunks = 16)
+        : m_Parts(nPartitions), m_bOrdered(bOrdered), m_nMaxChunks(nMaxChunks) {}
+
+    // called by the worker of partition nPart
+    void Push(size_t nPart, tstring&& chunk)
+    {
+        unique_lock<mutex> lock(m_Mutex);
+        m_Changed.wait(lock, [&] { return m_Parts[nPart].chunks.size() < m_nMaxChunks; });
+        m_Parts[nPart].chunks.push_back(std::move(chunk));
+        m_Changed.notify_all();
+    }
+
+    // called by the worker of partition nPart, when it has pushed its last chunk
+    void Finish(size_t nPart)
+    {
+        lock_guard<mutex> lock(m_Mutex);
+        m_Parts[nPart].bDone = true;
+        m_Changed.notify_all();
+    }
+
+    // Writes the chunks to os until all partitions are finished: either partition after partition 
+    // or each chunk as soon as it arrives.
+    void WriteTo(tostream& os)
+    {
+        size_t nCurrent = 0;
+        vector<tstring> chunks;
+        for (;;)
+        {
+            {
+                unique_lock<mutex> lock(m_Mutex);
+                if (m_bOrdered)
+                {
+                    m_Changed.wait(lock, [&] { return nCurrent == m_Parts.size() 
+                        || !m_Parts[nCurrent].chunks.empty() || m_Parts[nCurrent].bDone; });
+                    if (nCurrent == m_Parts.size())
+                        return;
+                    if (m_Parts[nCurrent].chunks.empty())
+                    {
+                        nCurrent++;
+                        continue;
+                    }
+                    chunks.push_back(std::move(m_Parts[nCurrent].chunks.front()));
+                    m_Parts[nCurrent].chunks.pop_front();
+                }
+                else
+                {
+                    bool bPending = false;
+                    m_Changed.wait(lock, [&] {
+                        bool bAllDone = true;
+                        for (const Partition& part : m_Parts)
+                        {
+                            bPending = bPending || !part.chunks.empty();
+                            bAllDone = bAllDone && part.bDone;
+                        }
+                        return bPending || bAllDone; 
+                    });
+                    if (!bPending)
+                        return;
+                    for (Partition& part : m_Parts)
+                    {
+                        for (tstring& chunk : part.chunks)
+                            chunks.push_back(std::move(chunk));
+                        part.chunks.clear();
+                    }
+                }
+                m_Changed.notify_all();
+            }
+
+            // write without holding the lock
+            for (const tstring& chunk : chunks)
+                os.write(chunk.data(), chunk.length());
+            chunks.clear();
+        }
+    }
+
+protected:
+    struct Partition
+    {
+        deque<tstring> chunks;
+        bool bDone = false;
+    };
+
+    vector<Partition> m_Parts;
+    bool m_bOrdered;
+    size_t m_nMaxChunks;
+    mutex m_Mutex;
+    condition_variable m_Changed;
+};
+
+// Stream buffer of a worker thread: hands the formatted output to the ChunkMerger 
+// each time nChunkSize characters are written and at Flush().
+class ChunkStreambuf : public tstreambuf
+{
+public:
+    ChunkStreambuf(ChunkMerger& merger, size_t nPart, size_t nChunkSize = 0x10000)
+        : m_Merger(merger), m_nPart(nPart), m_Buffer(nChunkSize)
+    {
+        setp(m_Buffer.data(), m_Buffer.data() + m_Buffer.size());
+    }
+
+    void Flush()
+    {
+        if (pptr() > pbase())
+            m_Merger.Push(m_nPart, tstring(pbase(), pptr()));
+        setp(m_Buffer.data(), m_Buffer.data() + m_Buffer.size());
+    }
+
+protected:
+    int_type overflow(int_type ch) override
+    {
+        Flush();
+        if (!traits_type::eq_int_type(ch, traits_type::eof()))
+        {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    // endl must not hand over a chunk for each line
+    int sync() override { return 0; }
+
+    ChunkMerger& m_Merger;
+    size_t m_nPart;
+    vector<TCHAR> m_Buffer;
+};
+
+// Extracts one partition over its own connection. The output goes either to the merger
+// or - for an odbc target - over its own target connection.
+static size_t ExportPartition(size_t nPart, const tstring& connectionstring, const tstring& sql, 
+    const ParallelOptions& options, ChunkMerger& merger)
+{
+    size_t nRows = 0;
+    Connection con;
+    if (!con.Open(connectionstring))
+        throw std::runtime_error("Cannot open connection of partition " + to_string(nPart));
+    Query query(con);
+#ifdef USE_ROWDATA
+    query.UseArena();
+#endif
+    if (options.nTimeout > 0)
+        query.SetQueryTimeout(options.nTimeout);
+    WatchQuery(query, options.nTimeout);
+    if (!options.datetimeformat.empty() && (options.insert.length() > 0 || options.insertvalues.length() > 0))
+        query.SetCTypeFormat(SQL_C_TIMESTAMP, options.datetimeformat);
+
+    ChunkStreambuf buf(merger, nPart);
+    Connection target;
+    TargetStream os(&buf);
+    if (options.targetconnection.length() > 0)
+    {
+        if (!target.Open(options.targetconnection))
+            throw std::runtime_error("Cannot open target of partition " + to_string(nPart));
+        os.SetConnection(target);
+        os.SetBatchSize(options.nBatchSize);
+        os.SetCommitEvery(options.nCommitRows, options.nCommitBytes);
+    }
+
+    SQLRETURN nRetCode = query.ExecDirect(sql);
+    if (SQL_SUCCEEDED(nRetCode))
+    {
+        if (options.rowformat.length() > 0)
+            nRows = os.OutputFormatted(query, options.rowformat);
+        else if (options.insert.length() > 0)
+            nRows = os.InsertAll(query, options.insert);
+        else if (options.insertvalues.length() > 0)
+            nRows = os.InsertValues(query, options.insertvalues);
+        else // the header has already been written by ParallelExport
+            nRows = os.OutputAsCSV(query, options.fieldseparator, options.decimalformat, options.datetimeformat, false);
+    }
+
+    if (os.IsODBC())
+        os.Commit();
+    else
+        buf.Flush();
+    target.Close();
+    con.Close();
+    return nRows;
+}
+
+// Splits the range [min, max] of the column options.partitionby into options.nPartitions disjoint
+// ranges and extracts them concurrently, each over its own connection. Rows where the column is null
+// go to the first partition.
+SQLRETURN ParallelExport(TargetStream& os, Query& query, const tstring& connectionstring, 
+    tstring sql, const ParallelOptions& options)
+{
+    auto start = chrono::steady_clock::now();
+
+    // the statement becomes a subquery
+    size_t nEnd = sql.find_last_not_of(_T("; \t\r\n"));
+    sql.erase(nEnd == tstring::npos ? 0 : nEnd + 1);
+    tstring subquery = _T("(") + sql + _T(") qx_p");
+    const tstring& col = options.partitionby;
+
+    SQLRETURN nRetCode = query.ExecDirect(_T("select min(") + col + _T("), max(") + col + _T(") from ") + subquery);
+    if (!SQL_SUCCEEDED(nRetCode))
+        return nRetCode;
+    vector<tstring> predicates;
+    if (query.Fetch() != SQL_NO_DATA)
+    {
+        DBItem minValue, maxValue;
+        query.GetFieldValue(0, minValue);
+        query.GetFieldValue(1, maxValue);
+        if (minValue.m_nVarType != DBItem::lwvt_null && maxValue.m_nVarType != DBItem::lwvt_null)
+        {
+            long long nMin = 0, nMax = 0;
+            try
+            {
+                nMin = stoll(DBItem::ConvertToString(minValue));
+                nMax = stoll(DBItem::ConvertToString(maxValue));
+            }
+            catch (const logic_error&)
+            {
+                tcerr << _T("Error: --partition-by ") << col << _T(" is not an integer column!") << endl;
+                return SQL_ERROR;
+            }
+            long long nStep = (nMax - nMin) / (long long) options.nPartitions + 1;
+            size_t nPartitions = (size_t) min((long long) options.nPartitions, (nMax - nMin) / nStep + 1);
+            for (size_t i = 0; i < nPartitions; i++)
+            {
+                // the first and the last range are open, so that every row belongs to exactly one partition
+                tstring predicate;
+                if (i > 0)
+                    predicate = col + string_format(_T(" >= %lld"), nMin + (long long) i * nStep);
+                if (i > 0 && i < nPartitions - 1)
+                    predicate += _T(" and ");
+                if (i < nPartitions - 1)
+                    predicate += col + string_format(_T(" < %lld"), nMin + (long long) (i + 1) * nStep);
+                if (nPartitions == 1)
+                    predicate = _T("1 = 1");
+                else if (i == 0)
+                    predicate = _T("(") + predicate + _T(" or ") + col + _T(" is null)");
+                predicates.push_back(predicate);
+            }
+        }
+    }
+    query.Close();
+    if (predicates.empty())
+        predicates.push_back(col + _T(" is null"));
+
+    bool bText = options.targetconnection.empty();
+    if (bText && options.rowformat.empty() && options.insert.empty() && options.insertvalues.empty())
+    {
+        // the CSV header is written once: from an empty result set with the same columns
+        nRetCode = query.ExecDirect(_T("select * from ") + subquery + _T(" where 1 = 0"));
+        if (SQL_SUCCEEDED(nRetCode))
+            os.OutputAsCSV(query, options.fieldseparator, options.decimalformat, options.datetimeformat);
+        query.Close();
+    }
+
+    ChunkMerger merger(predicates.size(), options.bOrdered);
+    vector<exception_ptr> errors(predicates.size());
+    vector<size_t> rows(predicates.size(), 0);
+    vector<thread> workers;
+    for (size_t i = 0; i < predicates.size(); i++)
+    {
+        tstring partsql = _T("select * from ") + subquery + _T(" where ") + predicates[i];
+        if (options.bVerbose)
+            tcerr << _T("Partition ") << i << _T(": ") << partsql << endl;
+        workers.emplace_back([&, i, partsql]() {
+            try
+            {
+                rows[i] = ExportPartition(i, connectionstring, partsql, options, merger);
+            }
+            catch (...)
+            {
+                errors[i] = current_exception();
+            }
+            merger.Finish(i);
+        });
+    }
+
+    merger.WriteTo(os);
+    for (thread& worker : workers)
+        worker.join();
+
+    for (exception_ptr& error : errors)
+    {
+        if (!error)
+            continue;
+        try
+        {
+            rethrow_exception(error);
+        }
+        catch (const DbException&)
+        {
+            throw;
+        }
+        catch (const exception& ex)
+        {
+            cerr << "Error: " << ex.what() << endl;
+            return SQL_ERROR;
+        }
+    }
+
+    if (options.bVerbose)
+    {
+        size_t nRows = 0;
+        for (size_t n : rows)
+            nRows += n;
+        ReportThroughput(nRows, start);
+    }
+
+    return SQL_SUCCESS;
+}
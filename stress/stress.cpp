@@ -0,0 +1,155 @@
+// Multi-threaded stress test: each worker thread repeatedly opens its own Connection,
+// inserts a row, reads its rows back and closes the connection again, all at the same time.
+// This exercises the shared ODBC environment, which is created by the first and released
+// by the last Connection, as well as the statement cache and pool of each connection.
+//
+// usage: stress [threads] [iterations] [database file]
+// The SQLite3 ODBC driver must be installed; the database file is created if necessary.
+
+#include <stdio.h>
+#include <cassert>
+#include <iostream>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <chrono>
+
+#include "../query/query.h"
+#include "../query/lvstring.h"
+
+#ifdef UNICODE
+#define tcout wcout
+#else
+#define tcout cout
+#endif
+
+using namespace std;
+using namespace linguversa;
+
+static tstring GetConnectionString(const tstring& database)
+{
+    // SQLite serializes writers, Timeout lets a blocked writer wait instead of failing with "database is locked"
+    #ifdef _WIN32
+    return _T("Driver={SQLite3 ODBC Driver};Database=") + database + _T(";Timeout=30000;");
+    #else
+    return _T("Driver=SQLITE3;Database=") + database + _T(";Timeout=30000;");
+    #endif
+}
+
+static void Worker(const tstring& connectionstring, int nThread, int nIterations,
+    atomic<int>& nErrors, atomic<int>& nStatements)
+{
+    for (int i = 0; i < nIterations; i++)
+    {
+        try
+        {
+            Connection con;
+            if (!con.Open(connectionstring))
+            {
+                nErrors++;
+                continue;
+            }
+            con.SetStatementCacheSize(4);
+
+            Query query(con);
+            query.ExecDirect(::string_format(
+                _T("insert into stress(thread, iteration, name) values (%d, %d, 'thread %d row %d');"),
+                nThread, i, nThread, i));
+            nStatements++;
+
+            // prepared with a parameter, so that the statement cache of the connection is used as well
+            query.Prepare(_T("select count(*) from stress where thread = ?;"));
+            long lThread = nThread;
+            query.BindParameter(1, lThread);
+            query.Execute();
+            nStatements++;
+
+            long nCount = -1;
+            if (query.Fetch() != SQL_NO_DATA)
+                query.GetFieldValue(0, nCount);
+            // each thread sees its own rows, whatever the other threads are doing
+            if (nCount != i + 1)
+            {
+                tcout << ::string_format(_T("thread %d: %ld rows instead of %d"), nThread, nCount, i + 1) << endl;
+                nErrors++;
+            }
+
+            query.Close();
+            con.Close();
+        }
+        catch (DbException& ex)
+        {
+            cout << "thread " << nThread << ": " << ex.what() << endl;
+            nErrors++;
+        }
+        catch (exception& ex)
+        {
+            cout << "thread " << nThread << ": " << ex.what() << endl;
+            nErrors++;
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int nThreads = (argc > 1) ? atoi(argv[1]) : 8;
+    int nIterations = (argc > 2) ? atoi(argv[2]) : 100;
+    string database = (argc > 3) ? argv[3] : "stress.db3";
+    if (nThreads <= 0 || nIterations <= 0)
+    {
+        cout << "usage: stress [threads] [iterations] [database file]" << endl;
+        return 1;
+    }
+
+    tstring connectionstring = GetConnectionString(tstring(database.begin(), database.end()));
+
+    try
+    {
+        Connection con;
+        if (!con.Open(connectionstring))
+        {
+            cout << "Cannot open " << database << endl;
+            return -1;
+        }
+
+        Query query(con);
+        query.ExecDirect(_T("drop table if exists stress;"));
+        query.ExecDirect(_T("create table stress(id integer primary key, thread int not null, iteration int not null, name varchar(50));"));
+        query.Close();
+        // con stays open until the workers are done, so the environment is shared with them
+        // and is released by the last connection at the end.
+
+        atomic<int> nErrors(0);
+        atomic<int> nStatements(0);
+        auto start = chrono::steady_clock::now();
+
+        vector<thread> workers;
+        for (int t = 0; t < nThreads; t++)
+            workers.emplace_back(Worker, connectionstring, t, nIterations, std::ref(nErrors), std::ref(nStatements));
+        for (thread& worker : workers)
+            worker.join();
+
+        double dSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        long nRows = -1;
+        query.ExecDirect(_T("select count(*) from stress;"));
+        if (query.Fetch() != SQL_NO_DATA)
+            query.GetFieldValue(0, nRows);
+        query.Close();
+        if (nRows != (long) nThreads * nIterations)
+        {
+            cout << nRows << " rows instead of " << nThreads * nIterations << endl;
+            nErrors++;
+        }
+
+        cout << nThreads << " threads, " << nIterations << " connections each, "
+            << nStatements.load() << " statements in " << dSeconds << " s, "
+            << nErrors.load() << " errors" << endl;
+        return (nErrors > 0) ? 1 : 0;
+    }
+    catch (DbException& ex)
+    {
+        cout << ex.what() << endl;
+        return ex.getSqlCode();
+    }
+}